@@ -0,0 +1,104 @@
+#include "admission_controller.h"
+
+#include <cmath>
+#include <string>
+
+using std::literals::string_literals::operator""s;
+
+AdmissionController::AdmissionController(AdmissionOptions options)
+    : options_(options) {
+}
+
+const AdmissionOptions& AdmissionController::GetOptions() const {
+    return options_;
+}
+
+bool AdmissionController::TryEnter() {
+    if (in_flight_.fetch_add(1, std::memory_order_relaxed) >= options_.max_in_flight) {
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void AdmissionController::Leave() {
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+AdmissionDecision AdmissionController::Admit(Clock::duration queue_delay, Clock::time_point now, bool can_degrade) {
+    AdmissionDecision decision = AdmissionDecision::ADMIT;
+    {
+        std::lock_guard guard(mutex_);
+        if (queue_delay < options_.target_delay) {
+            first_above_time_.reset();
+            is_overloaded_ = false;
+        } else if (!first_above_time_) {
+            first_above_time_ = now + options_.interval;
+        } else if (now >= *first_above_time_) {
+            if (!is_overloaded_) {
+                is_overloaded_ = true;
+                // an overload soon after the previous one starts near
+                // its shedding rate
+                const bool is_recent = now - next_shed_time_ < 16 * options_.interval;
+                shed_count_ = shed_count_ > 2 && is_recent ? shed_count_ - 2 : 0;
+                next_shed_time_ = now;
+            }
+            if (options_.shed_when_overloaded && now >= next_shed_time_) {
+                ++shed_count_;
+                next_shed_time_ = GetNextShedTime(now);
+                decision = AdmissionDecision::SHED;
+            } else if (options_.degrade_when_overloaded && can_degrade) {
+                decision = AdmissionDecision::DEGRADE;
+            }
+        }
+    }
+
+    switch (decision) {
+        case AdmissionDecision::ADMIT:
+            admitted_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case AdmissionDecision::DEGRADE:
+            degraded_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case AdmissionDecision::SHED:
+            shed_.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+    return decision;
+}
+
+AdmissionController::Statistics AdmissionController::GetStatistics() const {
+    Statistics statistics;
+    statistics.admitted = admitted_.load(std::memory_order_relaxed);
+    statistics.degraded = degraded_.load(std::memory_order_relaxed);
+    statistics.shed = shed_.load(std::memory_order_relaxed);
+    statistics.rejected = rejected_.load(std::memory_order_relaxed);
+    statistics.in_flight = in_flight_.load(std::memory_order_relaxed);
+    {
+        // the state changes only with queries, an idle server isn't overloaded
+        std::lock_guard guard(mutex_);
+        statistics.is_overloaded = is_overloaded_ && statistics.in_flight > 0;
+    }
+    return statistics;
+}
+
+void AdmissionController::WritePrometheus(std::ostream& out) const {
+    const Statistics statistics = GetStatistics();
+    out << "# HELP search_server_admission_queries_total Read queries by admission decision.\n"s;
+    out << "# TYPE search_server_admission_queries_total counter\n"s;
+    out << "search_server_admission_queries_total{decision=\"admitted\"} "s << statistics.admitted << '\n';
+    out << "search_server_admission_queries_total{decision=\"degraded\"} "s << statistics.degraded << '\n';
+    out << "search_server_admission_queries_total{decision=\"shed\"} "s << statistics.shed << '\n';
+    out << "search_server_admission_queries_total{decision=\"rejected\"} "s << statistics.rejected << '\n';
+    out << "# HELP search_server_admission_in_flight Read queries received and not answered yet.\n"s;
+    out << "# TYPE search_server_admission_in_flight gauge\n"s;
+    out << "search_server_admission_in_flight "s << statistics.in_flight << '\n';
+    out << "# HELP search_server_admission_overloaded Whether the queue delay stays above the target.\n"s;
+    out << "# TYPE search_server_admission_overloaded gauge\n"s;
+    out << "search_server_admission_overloaded "s << (statistics.is_overloaded ? 1 : 0) << '\n';
+}
+
+AdmissionController::Clock::time_point AdmissionController::GetNextShedTime(Clock::time_point time) const {
+    return time + std::chrono::duration_cast<Clock::duration>(options_.interval / std::sqrt(static_cast<double>(shed_count_)));
+}
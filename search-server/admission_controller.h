@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ostream>
+
+struct AdmissionOptions {
+    // queries received and not answered yet; more are rejected on arrival
+    size_t max_in_flight = 4096;
+    // the server is overloaded when the queue delay of queries stays
+    // above target_delay for an interval, as in CoDel
+    std::chrono::steady_clock::duration target_delay = std::chrono::milliseconds(5);
+    std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100);
+    // while overloaded searches read at most this many postings
+    bool degrade_when_overloaded = true;
+    size_t degraded_max_postings = 100'000;
+    // while overloaded queries are shed at a rate growing with the
+    // square root of the count of shed ones, as CoDel drops packets
+    bool shed_when_overloaded = true;
+};
+
+enum class AdmissionDecision {
+    ADMIT,
+    DEGRADE,
+    SHED,
+};
+
+// Admission control of read queries. Arrivals beyond the in-flight limit
+// are rejected at once; the queue delay of the others decides whether
+// they run in full, with a search budget or not at all. Counters are
+// relaxed atomics, the CoDel state is under a mutex
+class AdmissionController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Statistics {
+        uint64_t admitted = 0;
+        uint64_t degraded = 0;
+        uint64_t shed = 0;
+        // rejected at the in-flight limit
+        uint64_t rejected = 0;
+        size_t in_flight = 0;
+        bool is_overloaded = false;
+    };
+
+    explicit AdmissionController(AdmissionOptions options = {});
+
+    const AdmissionOptions& GetOptions() const;
+
+    // Counts a query in flight, false when the limit is reached
+    bool TryEnter();
+    void Leave();
+
+    // Decides on a query that waited queue_delay in the queue. A query
+    // that can't be degraded runs in full instead
+    AdmissionDecision Admit(Clock::duration queue_delay, Clock::time_point now, bool can_degrade = true);
+
+    Statistics GetStatistics() const;
+
+    // Prometheus text exposition format
+    void WritePrometheus(std::ostream& out) const;
+
+private:
+    const AdmissionOptions options_;
+
+    std::atomic<size_t> in_flight_ = 0;
+    std::atomic<uint64_t> admitted_ = 0;
+    std::atomic<uint64_t> degraded_ = 0;
+    std::atomic<uint64_t> shed_ = 0;
+    std::atomic<uint64_t> rejected_ = 0;
+
+    mutable std::mutex mutex_;
+    // end of the interval the delay has to stay above target
+    std::optional<Clock::time_point> first_above_time_;
+    bool is_overloaded_ = false;
+    // queries shed in this overload and the time of the next one
+    uint32_t shed_count_ = 0;
+    Clock::time_point next_shed_time_;
+
+    Clock::time_point GetNextShedTime(Clock::time_point time) const;
+};
@@ -0,0 +1,184 @@
+#include "benchmark_runner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+
+#include <unistd.h>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+// two-sided 95% quantiles of Student's t for 1..30 degrees of freedom
+const double T_QUANTILES_95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+void WriteJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u00"s << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 0xf];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+}  // namespace
+
+BenchmarkSummary ComputeSummary(std::vector<double> values) {
+    BenchmarkSummary summary;
+    if (values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    summary.min = values.front();
+    summary.max = values.back();
+    summary.median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / n;
+    if (n > 1) {
+        double squares = 0.0;
+        for (const double value : values) {
+            squares += (value - summary.mean) * (value - summary.mean);
+        }
+        summary.stddev = std::sqrt(squares / (n - 1));
+        const double t = n - 1 <= 30 ? T_QUANTILES_95[n - 2] : 1.96;
+        summary.ci95 = t * summary.stddev / std::sqrt(static_cast<double>(n));
+    }
+    return summary;
+}
+
+BenchmarkRunner::BenchmarkRunner(int repetitions, int warmup)
+    : repetitions_(std::max(1, repetitions))
+    , warmup_(std::max(0, warmup)) {
+}
+
+void BenchmarkRunner::SetPerfCounters(const PerfCounters* perf_counters) {
+    perf_counters_ = perf_counters && perf_counters->IsAvailable() ? perf_counters : nullptr;
+}
+
+void BenchmarkRunner::AddCountersPer(const std::string& unit, double count) {
+    if (results_.empty() || count <= 0) {
+        return;
+    }
+    auto& counters = results_.back().counters;
+    std::map<std::string, double> per_unit;
+    for (const auto& [name, value] : counters) {
+        if (name != "ipc"s && name.find("_per_"s) == std::string::npos) {
+            per_unit[name + "_per_"s + unit] = value / count;
+        }
+    }
+    counters.insert(per_unit.begin(), per_unit.end());
+}
+
+void BenchmarkRunner::AddCounter(const std::string& name, double value) {
+    if (!results_.empty()) {
+        results_.back().counters[name] = value;
+    }
+}
+
+void BenchmarkRunner::AddPerfCounters(BenchmarkResult& result, const std::vector<double>& totals) const {
+    if (!perf_counters_ || result.seconds.empty()) {
+        return;
+    }
+    const auto& names = perf_counters_->GetNames();
+    for (size_t i = 0; i < totals.size(); ++i) {
+        result.counters[names[i]] = totals[i] / result.seconds.size();
+    }
+    if (result.counters.count("cycles"s) && result.counters.count("instructions"s) && result.counters.at("cycles"s) > 0) {
+        result.counters["ipc"s] = result.counters.at("instructions"s) / result.counters.at("cycles"s);
+    }
+}
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::GetResults() const {
+    return results_;
+}
+
+void BenchmarkRunner::PrintText(std::ostream& out) const {
+    out << std::left << std::setw(28) << "benchmark"s << std::setw(22) << "corpus"s
+        << std::right << std::setw(12) << "median ms"s << std::setw(12) << "+-95% ms"s
+        << std::setw(14) << "ns/op"s << '\n';
+    for (const auto& result : results_) {
+        out << std::left << std::setw(28) << result.name << std::setw(22) << result.corpus << std::right
+            << std::fixed << std::setprecision(3)
+            << std::setw(12) << result.summary.median * 1e3
+            << std::setw(12) << result.summary.ci95 * 1e3
+            << std::setprecision(1)
+            << std::setw(14) << result.summary.median * 1e9 / std::max<size_t>(1, result.operations);
+        for (const auto& [counter, value] : result.counters) {
+            out << "  "s << counter << '=' << std::setprecision(3) << value;
+        }
+        out << '\n';
+    }
+    out << std::defaultfloat;
+}
+
+void BenchmarkRunner::WriteJson(std::ostream& out, const std::map<std::string, std::string>& context) const {
+    out << std::setprecision(9);
+    out << "{\n  \"context\": {"s;
+    bool is_first = true;
+    for (const auto& [key, value] : context) {
+        out << (is_first ? "\n    "s : ",\n    "s);
+        WriteJsonString(out, key);
+        out << ": "s;
+        WriteJsonString(out, value);
+        is_first = false;
+    }
+    out << "\n  },\n  \"benchmarks\": ["s;
+    for (size_t i = 0; i < results_.size(); ++i) {
+        const auto& result = results_[i];
+        out << (i == 0 ? "\n    {"s : ",\n    {"s);
+        out << "\"name\": "s;
+        WriteJsonString(out, result.name);
+        out << ", \"corpus\": "s;
+        WriteJsonString(out, result.corpus);
+        out << ", \"operations\": "s << result.operations
+            << ", \"repetitions\": "s << result.seconds.size()
+            << ", \"mean_s\": "s << result.summary.mean
+            << ", \"median_s\": "s << result.summary.median
+            << ", \"stddev_s\": "s << result.summary.stddev
+            << ", \"min_s\": "s << result.summary.min
+            << ", \"max_s\": "s << result.summary.max
+            << ", \"ci95_s\": "s << result.summary.ci95
+            << ", \"seconds\": ["s;
+        for (size_t j = 0; j < result.seconds.size(); ++j) {
+            out << (j == 0 ? ""s : ", "s) << result.seconds[j];
+        }
+        out << "], \"counters\": {"s;
+        is_first = true;
+        for (const auto& [counter, value] : result.counters) {
+            out << (is_first ? ""s : ", "s);
+            WriteJsonString(out, counter);
+            out << ": "s << value;
+            is_first = false;
+        }
+        out << "}}"s;
+    }
+    out << "\n  ]\n}\n"s;
+    out << std::defaultfloat;
+}
+
+void DoNotOptimize(uint64_t value) {
+    static volatile uint64_t sink = 0;
+    sink = sink + value;
+}
+
+size_t GetResidentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
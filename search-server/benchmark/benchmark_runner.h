@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "perf_counters.h"
+
+struct BenchmarkSummary {
+    double mean = 0.0;
+    double median = 0.0;
+    double stddev = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    // half-width of the 95% confidence interval of the mean
+    double ci95 = 0.0;
+};
+
+// Summary of repetition times in seconds, Student's t is used for the interval
+BenchmarkSummary ComputeSummary(std::vector<double> values);
+
+struct BenchmarkResult {
+    std::string name;
+    std::string corpus;
+    // operations done by one repetition, e.g. count of queries
+    size_t operations = 0;
+    std::vector<double> seconds;
+    BenchmarkSummary summary;
+    // additional values measured per repetition, averaged
+    std::map<std::string, double> counters;
+};
+
+// Runs every benchmark warmup + repetitions times; setup() prepares the
+// state of one repetition and isn't timed, body(state) is timed
+class BenchmarkRunner {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BenchmarkRunner(int repetitions, int warmup);
+
+    template <typename Setup, typename Body>
+    void Run(const std::string& name, const std::string& corpus, size_t operations, Setup setup, Body body);
+
+    // With counters, every benchmark also reports hardware events of
+    // the running thread per repetition and instructions per cycle
+    void SetPerfCounters(const PerfCounters* perf_counters);
+
+    // Adds every counter of the last benchmark divided by count of work
+    // units done by a repetition, e.g. llc_misses_per_posting
+    void AddCountersPer(const std::string& unit, double count);
+
+    // Adds a counter to the last benchmark
+    void AddCounter(const std::string& name, double value);
+
+    const std::vector<BenchmarkResult>& GetResults() const;
+
+    void PrintText(std::ostream& out) const;
+
+    void WriteJson(std::ostream& out, const std::map<std::string, std::string>& context) const;
+
+private:
+    int repetitions_;
+    int warmup_;
+    const PerfCounters* perf_counters_ = nullptr;
+    std::vector<BenchmarkResult> results_;
+
+    void AddPerfCounters(BenchmarkResult& result, const std::vector<double>& totals) const;
+};
+
+// Keeps the compiler from throwing away results of benchmarked code
+void DoNotOptimize(uint64_t value);
+
+// Resident set size of the process from /proc/self/statm, 0 without it
+size_t GetResidentBytes();
+
+template <typename Setup, typename Body>
+void BenchmarkRunner::Run(const std::string& name, const std::string& corpus, size_t operations,
+                          Setup setup, Body body) {
+    BenchmarkResult result;
+    result.name = name;
+    result.corpus = corpus;
+    result.operations = operations;
+    std::vector<double> perf_totals;
+    for (int i = 0; i < warmup_ + repetitions_; ++i) {
+        auto state = setup();
+        const std::vector<double> perf_start = perf_counters_ ? perf_counters_->Read() : std::vector<double>{};
+        const auto start_time = Clock::now();
+        body(state);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+        if (i >= warmup_) {
+            result.seconds.push_back(seconds);
+            if (perf_counters_) {
+                const std::vector<double> perf_finish = perf_counters_->Read();
+                perf_totals.resize(perf_finish.size());
+                for (size_t j = 0; j < perf_finish.size(); ++j) {
+                    perf_totals[j] += perf_finish[j] - perf_start[j];
+                }
+            }
+        }
+    }
+    result.summary = ComputeSummary(result.seconds);
+    AddPerfCounters(result, perf_totals);
+    results_.push_back(std::move(result));
+}
@@ -0,0 +1,145 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+std::string GenerateWord(std::mt19937& generator, int max_length) {
+    const int length = std::uniform_int_distribution(1, max_length)(generator);
+    std::string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(std::uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length) {
+    std::set<std::string> unique_words;
+    std::vector<std::string> words;
+    words.reserve(word_count);
+    // the dictionary is in generation order, so a word's Zipf rank is random
+    while (static_cast<int>(words.size()) < word_count) {
+        std::string word = GenerateWord(generator, max_length);
+        if (unique_words.insert(word).second) {
+            words.push_back(std::move(word));
+        }
+    }
+    return words;
+}
+
+DocumentStatus GenerateStatus(std::mt19937& generator, const std::vector<double>& weights) {
+    std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+    return static_cast<DocumentStatus>(distribution(generator));
+}
+
+}  // namespace
+
+ZipfDistribution::ZipfDistribution(int size, double exponent)
+    : cumulative_(size) {
+    double sum = 0.0;
+    for (int rank = 0; rank < size; ++rank) {
+        sum += 1.0 / std::pow(rank + 1.0, exponent);
+        cumulative_[rank] = sum;
+    }
+    for (double& value : cumulative_) {
+        value /= sum;
+    }
+}
+
+int ZipfDistribution::operator()(std::mt19937& generator) const {
+    const double value = std::uniform_real_distribution<>(0.0, 1.0)(generator);
+    const auto it = std::lower_bound(cumulative_.begin(), cumulative_.end(), value);
+    return static_cast<int>(std::min(it - cumulative_.begin(), static_cast<std::ptrdiff_t>(cumulative_.size() - 1)));
+}
+
+Corpus GenerateCorpus(const CorpusOptions& options) {
+    std::mt19937 generator(options.seed);
+    Corpus corpus;
+    corpus.options = options;
+    corpus.dictionary = GenerateDictionary(generator, options.dictionary_size, options.max_word_length);
+    const ZipfDistribution zipf(options.dictionary_size, options.zipf_exponent);
+
+    corpus.documents.reserve(options.document_count);
+    for (int id = 0; id < options.document_count; ++id) {
+        CorpusDocument document;
+        document.id = id;
+        document.status = GenerateStatus(generator, options.status_weights);
+        document.ratings = {std::uniform_int_distribution(-10, 10)(generator),
+                            std::uniform_int_distribution(-10, 10)(generator)};
+
+        const bool is_duplicate = id > 0
+            && std::uniform_real_distribution<>(0.0, 1.0)(generator) < options.duplicate_ratio;
+        if (is_duplicate) {
+            const auto& original = corpus.documents[std::uniform_int_distribution(0, id - 1)(generator)];
+            std::vector<std::string> words;
+            for (size_t pos = 0; pos < original.text.size();) {
+                const size_t space = std::min(original.text.find(' ', pos), original.text.size());
+                words.push_back(original.text.substr(pos, space - pos));
+                pos = space + 1;
+            }
+            std::shuffle(words.begin(), words.end(), generator);
+            for (const std::string& word : words) {
+                document.text += (document.text.empty() ? ""s : " "s) + word;
+            }
+        } else {
+            const int length = std::uniform_int_distribution(options.min_document_words,
+                                                             options.max_document_words)(generator);
+            for (int i = 0; i < length; ++i) {
+                if (!document.text.empty()) {
+                    document.text.push_back(' ');
+                }
+                document.text += corpus.dictionary[zipf(generator)];
+            }
+        }
+        corpus.documents.push_back(std::move(document));
+    }
+
+    corpus.queries.reserve(options.query_count);
+    for (int i = 0; i < options.query_count; ++i) {
+        std::string query;
+        for (int j = 0; j < options.query_words; ++j) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+            if (std::uniform_real_distribution<>(0.0, 1.0)(generator) < options.minus_word_ratio) {
+                query.push_back('-');
+            }
+            query += corpus.dictionary[zipf(generator)];
+        }
+        corpus.queries.push_back(std::move(query));
+    }
+    return corpus;
+}
+
+std::vector<CorpusOptions> GetDefaultCorpora() {
+    std::vector<CorpusOptions> corpora;
+
+    CorpusOptions uniform;
+    uniform.name = "uniform"s;
+    uniform.zipf_exponent = 0.0;
+    uniform.dictionary_size = 1'000;
+    uniform.query_words = 70;
+    uniform.minus_word_ratio = 0.0;
+    corpora.push_back(uniform);
+
+    CorpusOptions zipf;
+    zipf.name = "zipf"s;
+    zipf.duplicate_ratio = 0.05;
+    zipf.status_weights = {0.7, 0.1, 0.15, 0.05};
+    corpora.push_back(zipf);
+
+    CorpusOptions long_documents = zipf;
+    long_documents.name = "zipf_long_documents"s;
+    long_documents.document_count = 2'000;
+    long_documents.min_document_words = 300;
+    long_documents.max_document_words = 1'000;
+    long_documents.minus_word_ratio = 0.3;
+    corpora.push_back(long_documents);
+
+    return corpora;
+}
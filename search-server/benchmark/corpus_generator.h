@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "../document.h"
+
+// Parameters of a synthetic corpus. Words of documents and queries are
+// drawn from a Zipf distribution over the dictionary (zipf_exponent 0
+// gives the uniform distribution of the old main.cpp test)
+struct CorpusOptions {
+    std::string name = "zipf";
+    uint32_t seed = 42;
+    int document_count = 10'000;
+    int dictionary_size = 10'000;
+    int max_word_length = 10;
+    double zipf_exponent = 1.0;
+    int min_document_words = 10;
+    int max_document_words = 70;
+    // part of documents which repeat an earlier document with shuffled words
+    double duplicate_ratio = 0.0;
+    int query_count = 1'000;
+    int query_words = 8;
+    double minus_word_ratio = 0.1;
+    // weights of ACTUAL, IRRELEVANT, BANNED and REMOVED statuses
+    std::vector<double> status_weights = {1.0, 0.0, 0.0, 0.0};
+};
+
+struct CorpusDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct Corpus {
+    CorpusOptions options;
+    std::vector<std::string> dictionary;
+    std::vector<CorpusDocument> documents;
+    std::vector<std::string> queries;
+};
+
+// Samples ranks [0, size) with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(int size, double exponent);
+
+    int operator()(std::mt19937& generator) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+Corpus GenerateCorpus(const CorpusOptions& options);
+
+// Corpora used by the benchmarks when no options are given
+std::vector<CorpusOptions> GetDefaultCorpora();
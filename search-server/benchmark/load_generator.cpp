@@ -0,0 +1,288 @@
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+#include "../search_server.h"
+#include "../latency_histogram.h"
+#include "../query_log.h"
+#include "corpus_generator.h"
+
+using std::literals::string_literals::operator""s;
+
+/*
+ * Mixed read/write load generator for SearchServer.
+ *
+ * Build from the search-server directory:
+ *
+ *  g++ -std=c++17 -O2 -DNDEBUG benchmark/load_generator.cpp benchmark/corpus_generator.cpp \
+ *      $(ls *.cpp | grep -v main.cpp) -ltbb -lpthread -o load_generator
+ *
+ * Closed loop: every thread sends the next request when the previous one
+ * is done. Open loop: requests are scheduled at --rate per second and
+ * latency is measured from the scheduled start, so a stalled server is
+ * charged for the requests it delayed (coordinated omission correction).
+ * Service time, measured from the actual start, is reported as well.
+ *
+ * Options:
+ *  --mode closed|open     (closed)
+ *  --threads N            (hardware concurrency)
+ *  --duration SECONDS     (10)
+ *  --rate N               requests per second in open loop (1000)
+ *  --mix S,A,R            weights of search, add and remove (90,5,5)
+ *  --documents N          documents loaded before the run (10000)
+ *  --replay PATH          searches replay a RequestQueue query log; in
+ *                         open loop they keep the logged timing
+ *  --speed X              replay X times faster than logged (1)
+ */
+
+namespace {
+
+enum class Operation {
+    SEARCH,
+    ADD,
+    REMOVE,
+};
+
+const size_t OPERATION_COUNT = 3;
+const char* OPERATION_NAMES[OPERATION_COUNT] = {"search", "add", "remove"};
+
+struct Options {
+    bool is_open_loop = false;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    double duration_s = 10.0;
+    double rate = 1000.0;
+    std::vector<double> mix = {90.0, 5.0, 5.0};
+    int documents = 10'000;
+    std::string replay_path;
+    double speed = 1.0;
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Option "s + arg + " requires a value"s);
+        }
+        const std::string value = argv[++i];
+        if (arg == "--mode"s) {
+            if (value != "open"s && value != "closed"s) {
+                throw std::invalid_argument("Mode must be open or closed"s);
+            }
+            options.is_open_loop = value == "open"s;
+        } else if (arg == "--threads"s) {
+            options.threads = std::max(1, std::stoi(value));
+        } else if (arg == "--duration"s) {
+            options.duration_s = std::stod(value);
+        } else if (arg == "--rate"s) {
+            options.rate = std::stod(value);
+        } else if (arg == "--mix"s) {
+            options.mix.clear();
+            for (size_t pos = 0; pos <= value.size();) {
+                const size_t comma = std::min(value.find(',', pos), value.size());
+                options.mix.push_back(std::stod(value.substr(pos, comma - pos)));
+                pos = comma + 1;
+            }
+            if (options.mix.size() != OPERATION_COUNT) {
+                throw std::invalid_argument("Mix must contain three weights"s);
+            }
+        } else if (arg == "--documents"s) {
+            options.documents = std::stoi(value);
+        } else if (arg == "--replay"s) {
+            options.replay_path = value;
+        } else if (arg == "--speed"s) {
+            options.speed = std::stod(value);
+        } else {
+            throw std::invalid_argument("Unknown option "s + arg);
+        }
+    }
+    return options;
+}
+
+// SearchServer isn't synchronized, so searches share the lock and
+// updates of the index take it exclusively
+class LoadTarget {
+public:
+    LoadTarget(const Corpus& corpus, size_t preloaded)
+        : corpus_(corpus)
+        , search_server_(""s)
+        , next_document_(preloaded) {
+        for (size_t i = 0; i < preloaded; ++i) {
+            Add(i);
+        }
+    }
+
+    size_t Search(const std::string& query) const {
+        std::shared_lock guard(mutex_);
+        try {
+            return search_server_.FindTopDocuments(query).size();
+        } catch (const std::invalid_argument&) {
+            return 0;
+        }
+    }
+
+    void AddNext() {
+        const size_t index = next_document_.fetch_add(1);
+        if (index < corpus_.documents.size()) {
+            Add(index);
+        }
+    }
+
+    void RemoveRandom(std::mt19937& generator) {
+        const size_t limit = std::min(next_document_.load(), corpus_.documents.size());
+        const int id = corpus_.documents[std::uniform_int_distribution<size_t>(0, limit - 1)(generator)].id;
+        std::unique_lock guard(mutex_);
+        search_server_.RemoveDocument(id);
+    }
+
+private:
+    const Corpus& corpus_;
+    SearchServer search_server_;
+    mutable std::shared_mutex mutex_;
+    std::atomic<size_t> next_document_;
+
+    void Add(size_t index) {
+        const auto& document = corpus_.documents[index];
+        std::unique_lock guard(mutex_);
+        search_server_.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+};
+
+struct LoadStatistics {
+    LatencyHistogram latencies[OPERATION_COUNT];
+    LatencyHistogram service_times[OPERATION_COUNT];
+    std::atomic<uint64_t> empty_results{0};
+};
+
+void PrintStatistics(const LoadStatistics& statistics, double elapsed_s, bool is_open_loop) {
+    const auto print_row = [](const std::string& name, const LatencyHistogram& histogram, double elapsed_s) {
+        LatencyHistogram::Counts counts{};
+        histogram.AddTo(counts);
+        const uint64_t total = LatencyHistogram::ComputeTotal(counts);
+        std::cout << std::left << std::setw(18) << name << std::right
+                  << std::setw(10) << total
+                  << std::setw(12) << std::fixed << std::setprecision(1) << total / elapsed_s;
+        for (const double percentile : {50.0, 99.0, 99.9, 100.0}) {
+            std::cout << std::setw(12) << std::setprecision(1)
+                      << LatencyHistogram::ComputePercentile(counts, percentile) / 1e3;
+        }
+        std::cout << '\n';
+    };
+
+    std::cout << std::left << std::setw(18) << "operation"s << std::right << std::setw(10) << "count"s
+              << std::setw(12) << "per second"s << std::setw(12) << "p50 us"s << std::setw(12) << "p99 us"s
+              << std::setw(12) << "p999 us"s << std::setw(12) << "max us"s << '\n';
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        print_row(OPERATION_NAMES[i], statistics.latencies[i], elapsed_s);
+        if (is_open_loop) {
+            print_row(OPERATION_NAMES[i] + " service"s, statistics.service_times[i], elapsed_s);
+        }
+    }
+    std::cout << "empty search results: "s << statistics.empty_results.load() << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    using Clock = std::chrono::steady_clock;
+    try {
+        const Options options = ParseOptions(argc, argv);
+
+        std::vector<QueryLogRecord> replay;
+        if (!options.replay_path.empty()) {
+            std::ifstream in(options.replay_path);
+            if (!in) {
+                throw std::invalid_argument("Can't open "s + options.replay_path);
+            }
+            replay = ReadQueryLog(in);
+            if (replay.empty()) {
+                throw std::invalid_argument("Query log is empty"s);
+            }
+        }
+
+        CorpusOptions corpus_options;
+        // documents added during the run are taken from the tail of the corpus
+        corpus_options.document_count = options.documents * 2;
+        const Corpus corpus = GenerateCorpus(corpus_options);
+        LoadTarget target(corpus, options.documents);
+        LoadStatistics statistics;
+
+        const bool is_timed_replay = options.is_open_loop && !replay.empty();
+        std::atomic<uint64_t> next_request{0};
+        const auto start_time = Clock::now();
+        const auto end_time = start_time + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.duration_s));
+
+        const auto worker = [&](int thread_index) {
+            std::mt19937 generator(thread_index);
+            std::discrete_distribution<int> mix(options.mix.begin(), options.mix.end());
+            while (true) {
+                const uint64_t request = next_request.fetch_add(1);
+                const Operation operation = is_timed_replay ? Operation::SEARCH : static_cast<Operation>(mix(generator));
+                Clock::time_point intended_time = Clock::now();
+                if (is_timed_replay) {
+                    if (request >= replay.size()) {
+                        break;
+                    }
+                    intended_time = start_time + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double, std::micro>(replay[request].offset_us / options.speed));
+                } else if (options.is_open_loop) {
+                    intended_time = start_time + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(request / options.rate));
+                }
+                if (intended_time >= end_time) {
+                    break;
+                }
+                std::this_thread::sleep_until(intended_time);
+
+                const auto actual_start = Clock::now();
+                switch (operation) {
+                    case Operation::SEARCH: {
+                        const std::string& query = replay.empty()
+                            ? corpus.queries[request % corpus.queries.size()]
+                            : replay[request % replay.size()].query;
+                        if (target.Search(query) == 0) {
+                            ++statistics.empty_results;
+                        }
+                        break;
+                    }
+                    case Operation::ADD:
+                        target.AddNext();
+                        break;
+                    case Operation::REMOVE:
+                        target.RemoveRandom(generator);
+                        break;
+                }
+                const auto finish = Clock::now();
+                const size_t index = static_cast<size_t>(operation);
+                statistics.latencies[index].Record(std::chrono::duration_cast<std::chrono::nanoseconds>(finish - intended_time).count());
+                statistics.service_times[index].Record(std::chrono::duration_cast<std::chrono::nanoseconds>(finish - actual_start).count());
+                if (finish >= end_time) {
+                    break;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < options.threads; ++i) {
+            threads.emplace_back(worker, i);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        const double elapsed_s = std::chrono::duration<double>(Clock::now() - start_time).count();
+        std::cout << (options.is_open_loop ? "open loop at "s + std::to_string(options.rate) + " requests/s, "s : "closed loop, "s)
+                  << options.threads << " threads, "s << elapsed_s << " s"s << std::endl;
+        PrintStatistics(statistics, elapsed_s, options.is_open_loop);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: "s << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
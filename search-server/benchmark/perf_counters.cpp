@@ -0,0 +1,98 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using std::literals::string_literals::operator""s;
+
+#ifdef __linux__
+
+namespace {
+
+struct EventConfig {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t CacheReadMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+const EventConfig EVENTS[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"l1d_misses", PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {"llc_misses", PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_LL)},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+int OpenEvent(const EventConfig& event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // the calling thread on any CPU
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+    for (const EventConfig& event : EVENTS) {
+        const int fd = OpenEvent(event);
+        if (fd >= 0) {
+            fds_.push_back(fd);
+            names_.push_back(event.name);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (const int fd : fds_) {
+        close(fd);
+    }
+}
+
+std::vector<double> PerfCounters::Read() const {
+    std::vector<double> values;
+    values.reserve(fds_.size());
+    for (const int fd : fds_) {
+        uint64_t data[3] = {0, 0, 0};
+        if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0) {
+            values.push_back(0.0);
+            continue;
+        }
+        // value * time_enabled / time_running compensates multiplexing
+        values.push_back(static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+    return values;
+}
+
+#else
+
+PerfCounters::PerfCounters() = default;
+
+PerfCounters::~PerfCounters() = default;
+
+std::vector<double> PerfCounters::Read() const {
+    return {};
+}
+
+#endif
+
+bool PerfCounters::IsAvailable() const {
+    return !fds_.empty();
+}
+
+const std::vector<std::string>& PerfCounters::GetNames() const {
+    return names_;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hardware counters of the calling thread read through Linux
+// perf_event_open. Every event is opened separately, so events the CPU
+// or the kernel don't support are skipped; values are scaled when the
+// kernel multiplexes counters. On other systems, or when access is
+// denied (see /proc/sys/kernel/perf_event_paranoid), no event is open
+// and IsAvailable() returns false
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool IsAvailable() const;
+
+    // Names of the open events, in the order of values of Read
+    const std::vector<std::string>& GetNames() const;
+
+    // Current values of the counters since construction; the counters
+    // run all the time, so a measurement is a difference of two reads
+    std::vector<double> Read() const;
+
+private:
+    std::vector<int> fds_;
+    std::vector<std::string> names_;
+};
@@ -0,0 +1,372 @@
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <malloc.h>
+
+#include "../search_server.h"
+#include "../remove_duplicates.h"
+#include "../process_queries.h"
+#include "corpus_generator.h"
+#include "benchmark_runner.h"
+#include "perf_counters.h"
+
+using std::literals::string_literals::operator""s;
+
+/*
+ * Benchmarks of SearchServer on synthetic corpora.
+ *
+ * Build from the search-server directory:
+ *
+ *  g++ -std=c++17 -O2 -DNDEBUG benchmark/search_benchmark.cpp benchmark/corpus_generator.cpp \
+ *      benchmark/benchmark_runner.cpp benchmark/perf_counters.cpp $(ls *.cpp | grep -v main.cpp) -ltbb -lpthread -o search_benchmark
+ *
+ * Options:
+ *  --repetitions N   timed repetitions of every benchmark (10)
+ *  --warmup N        untimed repetitions before them (1)
+ *  --documents N     overrides count of documents of every corpus
+ *  --filter TEXT     runs only benchmarks whose name contains TEXT
+ *  --json PATH       writes results as JSON for comparison between releases
+ *  --perf on|off     hardware counters through perf_event_open (on). They
+ *                    cover the benchmark thread only, so values of parallel
+ *                    benchmarks miss the work of worker threads. Searches
+ *                    also report counters per scanned posting and per stage
+ */
+
+namespace {
+
+struct Options {
+    int repetitions = 10;
+    int warmup = 1;
+    int documents = 0;
+    std::string filter;
+    std::string json_path;
+    bool use_perf = true;
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Option "s + arg + " requires a value"s);
+        }
+        const std::string value = argv[++i];
+        if (arg == "--repetitions"s) {
+            options.repetitions = std::stoi(value);
+        } else if (arg == "--warmup"s) {
+            options.warmup = std::stoi(value);
+        } else if (arg == "--documents"s) {
+            options.documents = std::stoi(value);
+        } else if (arg == "--filter"s) {
+            options.filter = value;
+        } else if (arg == "--json"s) {
+            options.json_path = value;
+        } else if (arg == "--perf"s) {
+            options.use_perf = value != "off"s;
+        } else {
+            throw std::invalid_argument("Unknown option "s + arg);
+        }
+    }
+    return options;
+}
+
+std::unique_ptr<SearchServer> BuildServer(const Corpus& corpus) {
+    auto search_server = std::make_unique<SearchServer>(""s);
+    for (const auto& document : corpus.documents) {
+        search_server->AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    return search_server;
+}
+
+// RemoveDuplicates reports every duplicate to std::cout, which
+// would be measured instead of the search of duplicates
+class MuteCout {
+public:
+    MuteCout()
+        : old_buffer_(std::cout.rdbuf(nullptr)) {
+    }
+    ~MuteCout() {
+        std::cout.rdbuf(old_buffer_);
+    }
+private:
+    std::streambuf* old_buffer_;
+};
+
+// Sums differences of hardware counters over every stage of search
+class StageCounters : public StageObserver {
+public:
+    explicit StageCounters(const PerfCounters& perf_counters)
+        : perf_counters_(perf_counters) {
+    }
+
+    void OnStageStart(SearchStage stage) override {
+        starts_[static_cast<size_t>(stage)] = perf_counters_.Read();
+    }
+
+    void OnStageFinish(SearchStage stage) override {
+        const size_t index = static_cast<size_t>(stage);
+        const std::vector<double> finish = perf_counters_.Read();
+        totals_[index].resize(finish.size());
+        for (size_t i = 0; i < finish.size(); ++i) {
+            totals_[index][i] += finish[i] - starts_[index][i];
+        }
+        ++calls_[index];
+    }
+
+    void AddTo(BenchmarkRunner& runner) const {
+        for (size_t index = 0; index < SEARCH_STAGE_COUNT; ++index) {
+            if (calls_[index] == 0) {
+                continue;
+            }
+            const std::string stage = SearchMetrics::GetStageName(static_cast<SearchStage>(index));
+            for (size_t i = 0; i < totals_[index].size(); ++i) {
+                runner.AddCounter(stage + "."s + perf_counters_.GetNames()[i] + "_per_call"s,
+                                  totals_[index][i] / calls_[index]);
+            }
+        }
+    }
+
+private:
+    const PerfCounters& perf_counters_;
+    std::vector<double> starts_[SEARCH_STAGE_COUNT];
+    std::vector<double> totals_[SEARCH_STAGE_COUNT];
+    size_t calls_[SEARCH_STAGE_COUNT] = {};
+};
+
+// Postings read by the sequential search of all queries of the corpus
+size_t CountScannedPostings(const SearchServer& search_server, const Corpus& corpus) {
+    size_t postings = 0;
+    for (const std::string& query : corpus.queries) {
+        const auto [documents, trace] = search_server.ExplainTopDocuments(query);
+        postings += trace.postings_scanned;
+    }
+    return postings;
+}
+
+void RunCorpusBenchmarks(BenchmarkRunner& runner, const Corpus& corpus, const std::string& filter,
+                         const PerfCounters* perf_counters) {
+    const std::string& name = corpus.options.name;
+    const auto selected = [&filter](const std::string& benchmark) {
+        return filter.empty() || benchmark.find(filter) != std::string::npos;
+    };
+    const auto no_setup = [] { return 0; };
+    const auto server = BuildServer(corpus);
+    const size_t match_queries = std::min<size_t>(corpus.queries.size(), 100);
+    const size_t match_documents = std::min<size_t>(corpus.documents.size(), 10);
+    const double postings = perf_counters ? static_cast<double>(CountScannedPostings(*server, corpus)) : 0.0;
+
+    if (selected("add_document"s)) {
+        runner.Run("add_document"s, name, corpus.documents.size(),
+                   [] { return std::make_unique<SearchServer>(""s); },
+                   [&corpus](std::unique_ptr<SearchServer>& search_server) {
+                       for (const auto& document : corpus.documents) {
+                           search_server->AddDocument(document.id, document.text, document.status, document.ratings);
+                       }
+                   });
+        const IndexMemoryStats memory = server->GetMemoryStats();
+        runner.AddCounter("index_bytes"s, memory.GetTotalBytes());
+        runner.AddCounter("postings_bytes"s, memory.postings.GetTotalBytes());
+        runner.AddCounter("forward_index_bytes"s, memory.forward_index.GetTotalBytes());
+        // growth of the process, which includes what the allocator keeps
+        // besides the index. Memory freed by the builds above is returned
+        // first, or it would be reused without growth
+        malloc_trim(0);
+        const double resident_before = static_cast<double>(GetResidentBytes());
+        const auto measured_server = BuildServer(corpus);
+        runner.AddCounter("rss_growth_bytes"s, static_cast<double>(GetResidentBytes()) - resident_before);
+    }
+    if (selected("destroy_server"s)) {
+        runner.Run("destroy_server"s, name, corpus.documents.size(),
+                   [&corpus] { return BuildServer(corpus); },
+                   [](std::unique_ptr<SearchServer>& search_server) {
+                       search_server.reset();
+                   });
+    }
+    if (selected("find_top_documents_seq"s)) {
+        runner.Run("find_top_documents_seq"s, name, corpus.queries.size(), no_setup,
+                   [&corpus, &server](int) {
+                       for (const std::string& query : corpus.queries) {
+                           DoNotOptimize(server->FindTopDocuments(std::execution::seq, query).size());
+                       }
+                   });
+        runner.AddCountersPer("posting"s, postings);
+        if (perf_counters) {
+            StageCounters stage_counters(*perf_counters);
+            server->GetMetrics().SetEnabled(true);
+            server->GetMetrics().SetStageObserver(&stage_counters);
+            for (const std::string& query : corpus.queries) {
+                DoNotOptimize(server->FindTopDocuments(std::execution::seq, query).size());
+            }
+            server->GetMetrics().SetStageObserver(nullptr);
+            server->GetMetrics().SetEnabled(false);
+            stage_counters.AddTo(runner);
+        }
+    }
+    if (selected("build_impact_index"s)) {
+        runner.Run("build_impact_index"s, name, corpus.documents.size(),
+                   [&corpus] { return BuildServer(corpus); },
+                   [](std::unique_ptr<SearchServer>& search_server) {
+                       search_server->BuildImpactIndex();
+                   });
+    }
+    if (selected("find_top_documents_impact"s)) {
+        // a copy of the server, the other benchmarks search without impacts
+        const auto impact_server = BuildServer(corpus);
+        impact_server->BuildImpactIndex();
+        runner.Run("find_top_documents_impact"s, name, corpus.queries.size(), no_setup,
+                   [&corpus, &impact_server](int) {
+                       for (const std::string& query : corpus.queries) {
+                           DoNotOptimize(impact_server->FindTopDocuments(std::execution::seq, query).size());
+                       }
+                   });
+        runner.AddCounter("impact_index_bytes"s, impact_server->GetMemoryStats().impact_index.GetTotalBytes());
+    }
+    if (selected("find_top_documents_par"s)) {
+        runner.Run("find_top_documents_par"s, name, corpus.queries.size(), no_setup,
+                   [&corpus, &server](int) {
+                       for (const std::string& query : corpus.queries) {
+                           DoNotOptimize(server->FindTopDocuments(std::execution::par, query).size());
+                       }
+                   });
+        runner.AddCountersPer("posting"s, postings);
+    }
+    if (selected("find_top_allow_list"s)) {
+        // every other document is allowed by an ACL
+        DocumentBitmap acl;
+        for (const auto& document : corpus.documents) {
+            if (document.id % 2 == 0) {
+                acl.Add(document.id);
+            }
+        }
+        const DocumentBitmap allowed = server->GetDocumentIds(DocumentStatus::ACTUAL) & acl;
+        runner.Run("find_top_allow_list"s, name, corpus.queries.size(), no_setup,
+                   [&corpus, &server, &allowed](int) {
+                       for (const std::string& query : corpus.queries) {
+                           DoNotOptimize(server->FindTopDocuments(query, allowed).size());
+                       }
+                   });
+        runner.Run("find_top_acl_predicate"s, name, corpus.queries.size(), no_setup,
+                   [&corpus, &server, &acl](int) {
+                       for (const std::string& query : corpus.queries) {
+                           DoNotOptimize(server->FindTopDocuments(query,
+                               [&acl](int document_id, DocumentStatus status, int) {
+                                   return status == DocumentStatus::ACTUAL && acl.Contains(document_id);
+                               }).size());
+                       }
+                   });
+    }
+    if (selected("match_document_seq"s)) {
+        runner.Run("match_document_seq"s, name, match_queries * match_documents, no_setup,
+                   [&corpus, &server, match_queries, match_documents](int) {
+                       for (size_t q = 0; q < match_queries; ++q) {
+                           for (size_t d = 0; d < match_documents; ++d) {
+                               const auto [words, status] = server->MatchDocument(std::execution::seq, corpus.queries[q], corpus.documents[d].id);
+                               DoNotOptimize(words.size());
+                           }
+                       }
+                   });
+    }
+    if (selected("match_document_par"s)) {
+        runner.Run("match_document_par"s, name, match_queries * match_documents, no_setup,
+                   [&corpus, &server, match_queries, match_documents](int) {
+                       for (size_t q = 0; q < match_queries; ++q) {
+                           for (size_t d = 0; d < match_documents; ++d) {
+                               const auto [words, status] = server->MatchDocument(std::execution::par, corpus.queries[q], corpus.documents[d].id);
+                               DoNotOptimize(words.size());
+                           }
+                       }
+                   });
+    }
+    if (selected("match_documents"s)) {
+        std::vector<int> ids(match_documents);
+        for (size_t d = 0; d < match_documents; ++d) {
+            ids[d] = corpus.documents[d].id;
+        }
+        runner.Run("match_documents"s, name, match_queries * match_documents, no_setup,
+                   [&corpus, &server, &ids, match_queries](int) {
+                       for (size_t q = 0; q < match_queries; ++q) {
+                           DoNotOptimize(server->MatchDocuments(corpus.queries[q], ids).size());
+                       }
+                   });
+    }
+    if (selected("remove_document"s)) {
+        runner.Run("remove_document"s, name, (corpus.documents.size() + 9) / 10,
+                   [&corpus] { return BuildServer(corpus); },
+                   [&corpus](std::unique_ptr<SearchServer>& search_server) {
+                       for (size_t i = 0; i < corpus.documents.size(); i += 10) {
+                           search_server->RemoveDocument(corpus.documents[i].id);
+                       }
+                   });
+    }
+    if (selected("remove_duplicates"s)) {
+        runner.Run("remove_duplicates"s, name, corpus.documents.size(),
+                   [&corpus] { return BuildServer(corpus); },
+                   [](std::unique_ptr<SearchServer>& search_server) {
+                       MuteCout mute;
+                       RemoveDuplicates(*search_server);
+                   });
+    }
+    if (selected("process_queries"s)) {
+        runner.Run("process_queries"s, name, corpus.queries.size(), no_setup,
+                   [&corpus, &server](int) {
+                       DoNotOptimize(ProcessQueries(*server, corpus.queries).size());
+                   });
+        runner.AddCountersPer("posting"s, postings);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseOptions(argc, argv);
+        BenchmarkRunner runner(options.repetitions, options.warmup);
+        std::unique_ptr<PerfCounters> perf_counters;
+        if (options.use_perf) {
+            perf_counters = std::make_unique<PerfCounters>();
+            if (!perf_counters->IsAvailable()) {
+                std::cerr << "Hardware counters are not available, check perf_event_paranoid"s << std::endl;
+                perf_counters.reset();
+            }
+        }
+        runner.SetPerfCounters(perf_counters.get());
+        std::map<std::string, std::string> context = {
+            {"repetitions"s, std::to_string(options.repetitions)},
+            {"warmup"s, std::to_string(options.warmup)},
+            {"hardware_concurrency"s, std::to_string(std::thread::hardware_concurrency())},
+        };
+        if (perf_counters) {
+            std::string events;
+            for (const std::string& name : perf_counters->GetNames()) {
+                events += (events.empty() ? ""s : ","s) + name;
+            }
+            context["perf_events"s] = events;
+        }
+
+        for (CorpusOptions corpus_options : GetDefaultCorpora()) {
+            if (options.documents > 0) {
+                corpus_options.document_count = options.documents;
+            }
+            const Corpus corpus = GenerateCorpus(corpus_options);
+            context["corpus."s + corpus_options.name] =
+                std::to_string(corpus_options.document_count) + " documents, "s
+                + std::to_string(corpus_options.dictionary_size) + " words, zipf "s
+                + std::to_string(corpus_options.zipf_exponent) + ", seed "s
+                + std::to_string(corpus_options.seed);
+            RunCorpusBenchmarks(runner, corpus, options.filter, perf_counters.get());
+        }
+
+        runner.PrintText(std::cout);
+        if (!options.json_path.empty()) {
+            std::ofstream out(options.json_path);
+            runner.WriteJson(out, context);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: "s << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -41,6 +41,7 @@ public:
     
     void erase(const Key& key) {
         auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        std::lock_guard g(bucket.mutex);
         bucket.map.erase(key);
     }
  
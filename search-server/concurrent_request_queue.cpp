@@ -0,0 +1,94 @@
+#include "concurrent_request_queue.h"
+
+#include <thread>
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(const SearchServer& search_server,
+                                               Clock::duration window,
+                                               size_t bucket_count)
+    : search_server_(search_server)
+    , bucket_duration_(bucket_count > 0 ? window / static_cast<int64_t>(bucket_count) : Clock::duration::zero())
+    , bucket_count_(bucket_count)
+    , shard_count_(std::max(1u, std::thread::hardware_concurrency()))
+    , buckets_(new TimeBucket[bucket_count])
+    , counters_(new ShardCounters[bucket_count * shard_count_]) {
+    if (bucket_duration_ <= Clock::duration::zero()) {
+        throw std::invalid_argument("Window must be positive and not shorter than bucket_count ticks of the clock"s);
+    }
+}
+
+void ConcurrentRequestQueue::AddRequest(size_t results_num, Clock::duration latency) {
+    const int64_t slot = GetCurrentSlot();
+    TimeBucket& bucket = AcquireBucket(slot);
+    ShardCounters& counters = counters_[(slot % bucket_count_) * shard_count_ + GetThreadShard() % shard_count_];
+    counters.requests.fetch_add(1, std::memory_order_relaxed);
+    if (0 == results_num) {
+        counters.no_result_requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    bucket.latencies.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+}
+
+int ConcurrentRequestQueue::GetNoResultRequests() const {
+    return static_cast<int>(GetStatistics().no_result_requests);
+}
+
+ConcurrentRequestQueue::Statistics ConcurrentRequestQueue::GetStatistics() const {
+    using namespace std::chrono;
+
+    const int64_t current_slot = GetCurrentSlot();
+    Statistics statistics;
+    LatencyHistogram::Counts latencies{};
+    for (size_t b = 0; b < bucket_count_; ++b) {
+        const int64_t slot = buckets_[b].slot.load(std::memory_order_acquire);
+        if (slot < 0 || slot > current_slot || current_slot - slot >= static_cast<int64_t>(bucket_count_)) {
+            continue;
+        }
+        for (size_t s = 0; s < shard_count_; ++s) {
+            const ShardCounters& counters = counters_[b * shard_count_ + s];
+            statistics.requests += counters.requests.load(std::memory_order_relaxed);
+            statistics.no_result_requests += counters.no_result_requests.load(std::memory_order_relaxed);
+        }
+        buckets_[b].latencies.AddTo(latencies);
+    }
+
+    if (statistics.requests > 0) {
+        statistics.no_result_rate = static_cast<double>(statistics.no_result_requests) / statistics.requests;
+    }
+    const auto covered = std::min<Clock::duration>(Clock::now() - start_time_, bucket_duration_ * static_cast<int64_t>(bucket_count_));
+    const double covered_seconds = duration<double>(covered).count();
+    if (covered_seconds > 0) {
+        statistics.queries_per_second = statistics.requests / covered_seconds;
+    }
+    statistics.latency_p50_ns = LatencyHistogram::ComputePercentile(latencies, 50.0);
+    statistics.latency_p90_ns = LatencyHistogram::ComputePercentile(latencies, 90.0);
+    statistics.latency_p99_ns = LatencyHistogram::ComputePercentile(latencies, 99.0);
+    statistics.latency_p999_ns = LatencyHistogram::ComputePercentile(latencies, 99.9);
+    return statistics;
+}
+
+int64_t ConcurrentRequestQueue::GetCurrentSlot() const {
+    return (Clock::now() - start_time_) / bucket_duration_;
+}
+
+ConcurrentRequestQueue::TimeBucket& ConcurrentRequestQueue::AcquireBucket(int64_t slot) {
+    const size_t index = slot % bucket_count_;
+    TimeBucket& bucket = buckets_[index];
+    int64_t old_slot = bucket.slot.load(std::memory_order_acquire);
+    // the thread which moves the bucket to the new slot clears it
+    while (old_slot < slot) {
+        if (bucket.slot.compare_exchange_weak(old_slot, slot, std::memory_order_acq_rel)) {
+            for (size_t s = 0; s < shard_count_; ++s) {
+                counters_[index * shard_count_ + s].requests.store(0, std::memory_order_relaxed);
+                counters_[index * shard_count_ + s].no_result_requests.store(0, std::memory_order_relaxed);
+            }
+            bucket.latencies.Reset();
+            break;
+        }
+    }
+    return bucket;
+}
+
+size_t ConcurrentRequestQueue::GetThreadShard() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
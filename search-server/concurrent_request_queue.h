@@ -0,0 +1,78 @@
+#pragma once
+#include "search_server.h"
+#include "latency_histogram.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Thread-safe counterpart of RequestQueue. Statistics cover the last
+// window of real (monotonic) time, which is split into bucket_count
+// buckets kept in a ring buffer; a bucket is reset by the first request
+// that lands in it after it expires. Counters of every bucket are
+// sharded by thread, so search threads don't write to the same cache
+// line. All updates are relaxed atomics: a request recorded while its
+// bucket is being reset may be lost, which is acceptable for statistics.
+class ConcurrentRequestQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Statistics {
+        uint64_t requests = 0;
+        uint64_t no_result_requests = 0;
+        double no_result_rate = 0.0;
+        double queries_per_second = 0.0;
+        uint64_t latency_p50_ns = 0;
+        uint64_t latency_p90_ns = 0;
+        uint64_t latency_p99_ns = 0;
+        uint64_t latency_p999_ns = 0;
+    };
+
+    explicit ConcurrentRequestQueue(const SearchServer& search_server,
+                                    Clock::duration window = std::chrono::minutes(1),
+                                    size_t bucket_count = 60);
+
+    template <typename... FindArgs>
+    std::vector<Document> AddFindRequest(const std::string_view raw_query, FindArgs&&... find_args);
+
+    // Records an outcome of a request which was executed by the caller
+    void AddRequest(size_t results_num, Clock::duration latency);
+
+    int GetNoResultRequests() const;
+
+    Statistics GetStatistics() const;
+
+private:
+    struct alignas(64) ShardCounters {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> no_result_requests{0};
+    };
+
+    struct TimeBucket {
+        std::atomic<int64_t> slot{-1};
+        LatencyHistogram latencies;
+    };
+
+    const SearchServer& search_server_;
+    const Clock::time_point start_time_ = Clock::now();
+    const Clock::duration bucket_duration_;
+    const size_t bucket_count_;
+    const size_t shard_count_;
+    std::unique_ptr<TimeBucket[]> buckets_;
+    // counters of bucket b and shard s are at b * shard_count_ + s
+    std::unique_ptr<ShardCounters[]> counters_;
+
+    int64_t GetCurrentSlot() const;
+
+    TimeBucket& AcquireBucket(int64_t slot);
+
+    static size_t GetThreadShard();
+};
+
+template <typename... FindArgs>
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string_view raw_query,
+                                                             FindArgs&&... find_args) {
+    const auto start = Clock::now();
+    auto result = search_server_.FindTopDocuments(raw_query, std::forward<FindArgs>(find_args)...);
+    AddRequest(result.size(), Clock::now() - start);
+    return result;
+}
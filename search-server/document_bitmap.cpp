@@ -0,0 +1,426 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+const uint32_t MAX_ARRAY_SIZE = 4096;
+const size_t BITSET_WORDS = (1 << 16) / 64;
+
+uint16_t GetKey(int document_id) {
+    return static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+}
+
+uint16_t GetLow(int document_id) {
+    return static_cast<uint16_t>(document_id & 0xffff);
+}
+
+}  // namespace
+
+DocumentBitmap::Iterator::Iterator(const std::vector<Chunk>* chunks, size_t chunk_index)
+    : chunks_(chunks), chunk_index_(chunk_index) {
+    SetChunkStart();
+}
+
+void DocumentBitmap::Iterator::SetChunkStart() {
+    value_index_ = 0;
+    position_ = 0;
+    if (chunk_index_ >= chunks_->size()) {
+        return;
+    }
+    const Chunk& chunk = (*chunks_)[chunk_index_];
+    if (chunk.bits.empty()) {
+        position_ = chunk.values[0];
+        return;
+    }
+    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+        if (chunk.bits[word] != 0) {
+            position_ = static_cast<uint32_t>(word * 64 + __builtin_ctzll(chunk.bits[word]));
+            return;
+        }
+    }
+}
+
+DocumentBitmap::Iterator& DocumentBitmap::Iterator::operator++() {
+    const Chunk& chunk = (*chunks_)[chunk_index_];
+    if (chunk.bits.empty()) {
+        if (++value_index_ < chunk.values.size()) {
+            position_ = chunk.values[value_index_];
+            return *this;
+        }
+    } else {
+        // bits up to the current one are masked out of its word
+        const uint32_t next = position_ + 1;
+        size_t word = next / 64;
+        uint64_t bits = word < BITSET_WORDS ? chunk.bits[word] & (~uint64_t(0) << (next % 64)) : 0;
+        while (bits == 0 && ++word < BITSET_WORDS) {
+            bits = chunk.bits[word];
+        }
+        if (bits != 0) {
+            position_ = static_cast<uint32_t>(word * 64 + __builtin_ctzll(bits));
+            return *this;
+        }
+    }
+    ++chunk_index_;
+    SetChunkStart();
+    return *this;
+}
+
+void DocumentBitmap::Add(int document_id) {
+    if (document_id < 0) {
+        throw std::invalid_argument("Document id must not be negative"s);
+    }
+    const uint16_t key = GetKey(document_id);
+    const uint16_t low = GetLow(document_id);
+    auto chunk_it = FindChunk(key);
+    if (chunk_it == chunks_.end() || chunk_it->key != key) {
+        chunk_it = chunks_.insert(chunk_it, Chunk{key, 0, {}, {}});
+    }
+    Chunk& chunk = *chunk_it;
+    if (!chunk.bits.empty()) {
+        uint64_t& word = chunk.bits[low / 64];
+        const uint64_t mask = uint64_t(1) << (low % 64);
+        if (word & mask) {
+            return;
+        }
+        word |= mask;
+    } else {
+        const auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+        if (it != chunk.values.end() && *it == low) {
+            return;
+        }
+        chunk.values.insert(it, low);
+    }
+    ++chunk.size;
+    ++size_;
+    Normalize(chunk);
+}
+
+void DocumentBitmap::Remove(int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+    const uint16_t key = GetKey(document_id);
+    const uint16_t low = GetLow(document_id);
+    const auto chunk_it = FindChunk(key);
+    if (chunk_it == chunks_.end() || chunk_it->key != key) {
+        return;
+    }
+    Chunk& chunk = *chunk_it;
+    if (!chunk.bits.empty()) {
+        uint64_t& word = chunk.bits[low / 64];
+        const uint64_t mask = uint64_t(1) << (low % 64);
+        if (!(word & mask)) {
+            return;
+        }
+        word &= ~mask;
+    } else {
+        const auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+        if (it == chunk.values.end() || *it != low) {
+            return;
+        }
+        chunk.values.erase(it);
+    }
+    --chunk.size;
+    --size_;
+    if (chunk.size == 0) {
+        chunks_.erase(chunk_it);
+    } else {
+        Normalize(chunk);
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const {
+    if (document_id < 0) {
+        return false;
+    }
+    const uint16_t key = GetKey(document_id);
+    const auto chunk_it = FindChunk(key);
+    return chunk_it != chunks_.end() && chunk_it->key == key && ChunkContains(*chunk_it, GetLow(document_id));
+}
+
+size_t DocumentBitmap::GetSize() const {
+    return size_;
+}
+
+bool DocumentBitmap::IsEmpty() const {
+    return size_ == 0;
+}
+
+int DocumentBitmap::GetMin() const {
+    return *begin();
+}
+
+int DocumentBitmap::GetMax() const {
+    const Chunk& chunk = chunks_.back();
+    uint32_t low = 0;
+    if (chunk.bits.empty()) {
+        low = chunk.values.back();
+    } else {
+        for (size_t word = BITSET_WORDS; word-- > 0;) {
+            if (chunk.bits[word] != 0) {
+                low = static_cast<uint32_t>(word * 64 + 63 - __builtin_clzll(chunk.bits[word]));
+                break;
+            }
+        }
+    }
+    return static_cast<int>((static_cast<uint32_t>(chunk.key) << 16) | low);
+}
+
+DocumentBitmap::Iterator DocumentBitmap::begin() const {
+    return Iterator(&chunks_, 0);
+}
+
+DocumentBitmap::Iterator DocumentBitmap::end() const {
+    return Iterator(&chunks_, chunks_.size());
+}
+
+DocumentBitmap& DocumentBitmap::operator&=(const DocumentBitmap& other) {
+    std::vector<Chunk> chunks;
+    auto other_it = other.chunks_.begin();
+    for (Chunk& chunk : chunks_) {
+        while (other_it != other.chunks_.end() && other_it->key < chunk.key) {
+            ++other_it;
+        }
+        if (other_it == other.chunks_.end()) {
+            break;
+        }
+        if (other_it->key != chunk.key) {
+            continue;
+        }
+        const Chunk& other_chunk = *other_it;
+        if (chunk.bits.empty() && other_chunk.bits.empty()) {
+            std::vector<uint16_t> values;
+            std::set_intersection(chunk.values.begin(), chunk.values.end(),
+                                  other_chunk.values.begin(), other_chunk.values.end(),
+                                  std::back_inserter(values));
+            chunk.values = std::move(values);
+            chunk.size = static_cast<uint32_t>(chunk.values.size());
+        } else if (chunk.bits.empty()) {
+            chunk.values.erase(std::remove_if(chunk.values.begin(), chunk.values.end(),
+                                              [&other_chunk](uint16_t value) {
+                                                  return !ChunkContains(other_chunk, value);
+                                              }),
+                               chunk.values.end());
+            chunk.size = static_cast<uint32_t>(chunk.values.size());
+        } else if (other_chunk.bits.empty()) {
+            std::vector<uint16_t> values;
+            std::copy_if(other_chunk.values.begin(), other_chunk.values.end(), std::back_inserter(values),
+                         [&chunk](uint16_t value) {
+                             return ChunkContains(chunk, value);
+                         });
+            std::vector<uint64_t>().swap(chunk.bits);
+            chunk.values = std::move(values);
+            chunk.size = static_cast<uint32_t>(chunk.values.size());
+        } else {
+            for (size_t word = 0; word < BITSET_WORDS; ++word) {
+                chunk.bits[word] &= other_chunk.bits[word];
+            }
+            CountBits(chunk);
+            Normalize(chunk);
+        }
+        if (chunk.size > 0) {
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    chunks_ = std::move(chunks);
+    UpdateSize();
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+    std::vector<Chunk> chunks;
+    chunks.reserve(chunks_.size() + other.chunks_.size());
+    auto it = chunks_.begin();
+    auto other_it = other.chunks_.begin();
+    while (it != chunks_.end() || other_it != other.chunks_.end()) {
+        if (other_it == other.chunks_.end() || (it != chunks_.end() && it->key < other_it->key)) {
+            chunks.push_back(std::move(*it++));
+            continue;
+        }
+        if (it == chunks_.end() || other_it->key < it->key) {
+            chunks.push_back(*other_it++);
+            continue;
+        }
+        Chunk& chunk = *it;
+        const Chunk& other_chunk = *other_it;
+        if (chunk.bits.empty() && other_chunk.bits.empty()) {
+            std::vector<uint16_t> values;
+            std::set_union(chunk.values.begin(), chunk.values.end(),
+                           other_chunk.values.begin(), other_chunk.values.end(),
+                           std::back_inserter(values));
+            chunk.values = std::move(values);
+            chunk.size = static_cast<uint32_t>(chunk.values.size());
+        } else {
+            ToBitset(chunk);
+            if (other_chunk.bits.empty()) {
+                for (const uint16_t value : other_chunk.values) {
+                    chunk.bits[value / 64] |= uint64_t(1) << (value % 64);
+                }
+            } else {
+                for (size_t word = 0; word < BITSET_WORDS; ++word) {
+                    chunk.bits[word] |= other_chunk.bits[word];
+                }
+            }
+            CountBits(chunk);
+        }
+        Normalize(chunk);
+        chunks.push_back(std::move(chunk));
+        ++it;
+        ++other_it;
+    }
+    chunks_ = std::move(chunks);
+    UpdateSize();
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator-=(const DocumentBitmap& other) {
+    std::vector<Chunk> chunks;
+    auto other_it = other.chunks_.begin();
+    for (Chunk& chunk : chunks_) {
+        while (other_it != other.chunks_.end() && other_it->key < chunk.key) {
+            ++other_it;
+        }
+        if (other_it != other.chunks_.end() && other_it->key == chunk.key) {
+            const Chunk& other_chunk = *other_it;
+            if (chunk.bits.empty()) {
+                chunk.values.erase(std::remove_if(chunk.values.begin(), chunk.values.end(),
+                                                  [&other_chunk](uint16_t value) {
+                                                      return ChunkContains(other_chunk, value);
+                                                  }),
+                                   chunk.values.end());
+                chunk.size = static_cast<uint32_t>(chunk.values.size());
+            } else {
+                if (other_chunk.bits.empty()) {
+                    for (const uint16_t value : other_chunk.values) {
+                        chunk.bits[value / 64] &= ~(uint64_t(1) << (value % 64));
+                    }
+                } else {
+                    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+                        chunk.bits[word] &= ~other_chunk.bits[word];
+                    }
+                }
+                CountBits(chunk);
+                Normalize(chunk);
+            }
+        }
+        if (chunk.size > 0) {
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    chunks_ = std::move(chunks);
+    UpdateSize();
+    return *this;
+}
+
+bool DocumentBitmap::operator==(const DocumentBitmap& other) const {
+    // representation of a chunk depends only on its size
+    return size_ == other.size_
+        && std::equal(chunks_.begin(), chunks_.end(), other.chunks_.begin(), other.chunks_.end(),
+                      [](const Chunk& lhs, const Chunk& rhs) {
+                          return lhs.key == rhs.key && lhs.size == rhs.size
+                              && lhs.values == rhs.values && lhs.bits == rhs.bits;
+                      });
+}
+
+bool DocumentBitmap::operator!=(const DocumentBitmap& other) const {
+    return !(*this == other);
+}
+
+size_t DocumentBitmap::GetPayloadBytes() const {
+    size_t bytes = chunks_.size() * sizeof(Chunk);
+    for (const Chunk& chunk : chunks_) {
+        bytes += chunk.values.size() * sizeof(uint16_t) + chunk.bits.size() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+size_t DocumentBitmap::GetCapacityBytes() const {
+    size_t bytes = chunks_.capacity() * sizeof(Chunk);
+    for (const Chunk& chunk : chunks_) {
+        bytes += chunk.values.capacity() * sizeof(uint16_t) + chunk.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+bool DocumentBitmap::ChunkContains(const Chunk& chunk, uint16_t value) {
+    if (!chunk.bits.empty()) {
+        return (chunk.bits[value / 64] >> (value % 64)) & 1;
+    }
+    return std::binary_search(chunk.values.begin(), chunk.values.end(), value);
+}
+
+void DocumentBitmap::Normalize(Chunk& chunk) {
+    if (chunk.bits.empty() && chunk.size > MAX_ARRAY_SIZE) {
+        ToBitset(chunk);
+    } else if (!chunk.bits.empty() && chunk.size <= MAX_ARRAY_SIZE) {
+        std::vector<uint16_t> values;
+        values.reserve(chunk.size);
+        for (size_t word = 0; word < BITSET_WORDS; ++word) {
+            for (uint64_t bits = chunk.bits[word]; bits != 0; bits &= bits - 1) {
+                values.push_back(static_cast<uint16_t>(word * 64 + __builtin_ctzll(bits)));
+            }
+        }
+        chunk.values = std::move(values);
+        std::vector<uint64_t>().swap(chunk.bits);
+    }
+}
+
+void DocumentBitmap::ToBitset(Chunk& chunk) {
+    if (!chunk.bits.empty()) {
+        return;
+    }
+    chunk.bits.assign(BITSET_WORDS, 0);
+    for (const uint16_t value : chunk.values) {
+        chunk.bits[value / 64] |= uint64_t(1) << (value % 64);
+    }
+    std::vector<uint16_t>().swap(chunk.values);
+}
+
+void DocumentBitmap::CountBits(Chunk& chunk) {
+    uint32_t size = 0;
+    for (const uint64_t bits : chunk.bits) {
+        size += static_cast<uint32_t>(__builtin_popcountll(bits));
+    }
+    chunk.size = size;
+}
+
+std::vector<DocumentBitmap::Chunk>::iterator DocumentBitmap::FindChunk(uint16_t key) {
+    return std::lower_bound(chunks_.begin(), chunks_.end(), key,
+                            [](const Chunk& chunk, uint16_t key) {
+                                return chunk.key < key;
+                            });
+}
+
+std::vector<DocumentBitmap::Chunk>::const_iterator DocumentBitmap::FindChunk(uint16_t key) const {
+    return std::lower_bound(chunks_.begin(), chunks_.end(), key,
+                            [](const Chunk& chunk, uint16_t key) {
+                                return chunk.key < key;
+                            });
+}
+
+void DocumentBitmap::UpdateSize() {
+    size_ = 0;
+    for (const Chunk& chunk : chunks_) {
+        size_ += chunk.size;
+    }
+}
+
+DocumentBitmap operator&(DocumentBitmap lhs, const DocumentBitmap& rhs) {
+    lhs &= rhs;
+    return lhs;
+}
+
+DocumentBitmap operator|(DocumentBitmap lhs, const DocumentBitmap& rhs) {
+    lhs |= rhs;
+    return lhs;
+}
+
+DocumentBitmap operator-(DocumentBitmap lhs, const DocumentBitmap& rhs) {
+    lhs -= rhs;
+    return lhs;
+}
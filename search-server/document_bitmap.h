@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// Set of document ids laid out like a roaring bitmap: ids are split into
+// chunks of 2^16 by their high bits, a chunk keeps up to 4096 ids as a
+// sorted array of the low 16 bits and more of them as a bitset of 8 KB.
+// Both take at most 2 bytes per id, and set operations work on whole
+// chunks
+class DocumentBitmap {
+private:
+    struct Chunk {
+        uint16_t key = 0;
+        uint32_t size = 0;
+        // the chunk is a bitset when bits is not empty
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> bits;
+    };
+
+public:
+    // Ids in ascending order
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        Iterator(const std::vector<Chunk>* chunks, size_t chunk_index);
+
+        int operator*() const {
+            return static_cast<int>((static_cast<uint32_t>((*chunks_)[chunk_index_].key) << 16) | position_);
+        }
+
+        Iterator& operator++();
+
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return chunk_index_ == other.chunk_index_ && position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const std::vector<Chunk>* chunks_;
+        size_t chunk_index_;
+        // low bits of the current id
+        uint32_t position_ = 0;
+        // index in values of an array chunk
+        size_t value_index_ = 0;
+
+        void SetChunkStart();
+    };
+
+    // Throws std::invalid_argument for negative ids
+    void Add(int document_id);
+    void Remove(int document_id);
+    bool Contains(int document_id) const;
+
+    size_t GetSize() const;
+    bool IsEmpty() const;
+    // Smallest and largest id of a non-empty bitmap
+    int GetMin() const;
+    int GetMax() const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    DocumentBitmap& operator&=(const DocumentBitmap& other);
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+    // Removes the ids of other
+    DocumentBitmap& operator-=(const DocumentBitmap& other);
+
+    bool operator==(const DocumentBitmap& other) const;
+    bool operator!=(const DocumentBitmap& other) const;
+
+    // Bytes of the ids and of the chunk headers, and bytes reserved
+    size_t GetPayloadBytes() const;
+    size_t GetCapacityBytes() const;
+
+private:
+    std::vector<Chunk> chunks_;
+    size_t size_ = 0;
+
+    static bool ChunkContains(const Chunk& chunk, uint16_t value);
+    // Array below 4097 ids, bitset above
+    static void Normalize(Chunk& chunk);
+    static void ToBitset(Chunk& chunk);
+    static void CountBits(Chunk& chunk);
+
+    std::vector<Chunk>::iterator FindChunk(uint16_t key);
+    std::vector<Chunk>::const_iterator FindChunk(uint16_t key) const;
+    void UpdateSize();
+};
+
+DocumentBitmap operator&(DocumentBitmap lhs, const DocumentBitmap& rhs);
+DocumentBitmap operator|(DocumentBitmap lhs, const DocumentBitmap& rhs);
+DocumentBitmap operator-(DocumentBitmap lhs, const DocumentBitmap& rhs);
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+// Word of a document in the forward index: id of the word in the
+// dictionary of the server and count of the word in the document
+struct ForwardEntry {
+    uint32_t term_id = 0;
+    uint32_t count = 0;
+};
+
+// Words of a document with their TF, in alphabetical order. Points into
+// the index of the server, so it is valid until the next AddDocument
+// or RemoveDocument
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const ForwardEntry* entry, const std::string_view* term_words, double inv_word_count)
+            : entry_(entry), term_words_(term_words), inv_word_count_(inv_word_count) {}
+
+        value_type operator*() const {
+            return {term_words_[entry_->term_id], entry_->count * inv_word_count_};
+        }
+
+        // id of the word in the dictionary of the server
+        uint32_t GetTermId() const {
+            return entry_->term_id;
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++entry_;
+            return result;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        const ForwardEntry* entry_;
+        const std::string_view* term_words_;
+        double inv_word_count_;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const ForwardEntry* begin, const ForwardEntry* end,
+                    const std::string_view* term_words, int word_count)
+        : begin_(begin), end_(end), term_words_(term_words)
+        , inv_word_count_(word_count > 0 ? 1.0 / word_count : 0.0) {}
+
+    Iterator begin() const {
+        return {begin_, term_words_, inv_word_count_};
+    }
+
+    Iterator end() const {
+        return {end_, term_words_, inv_word_count_};
+    }
+
+    size_t size() const {
+        return end_ - begin_;
+    }
+
+    bool empty() const {
+        return begin_ == end_;
+    }
+
+private:
+    const ForwardEntry* begin_ = nullptr;
+    const ForwardEntry* end_ = nullptr;
+    const std::string_view* term_words_ = nullptr;
+    double inv_word_count_ = 0.0;
+};
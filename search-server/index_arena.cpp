@@ -0,0 +1,127 @@
+#include "index_arena.h"
+
+#include <algorithm>
+#include <new>
+
+IndexArena::~IndexArena() {
+    Release();
+}
+
+void IndexArena::Release() {
+    while (chunks_) {
+        Chunk* next = chunks_->next;
+        ::operator delete(chunks_);
+        chunks_ = next;
+    }
+    while (large_blocks_) {
+        LargeBlock* next = large_blocks_->next;
+        ::operator delete(large_blocks_, std::align_val_t(large_blocks_->alignment));
+        large_blocks_ = next;
+    }
+    free_lists_.fill(nullptr);
+    chunk_position_ = nullptr;
+    chunk_end_ = nullptr;
+    next_chunk_size_ = FIRST_CHUNK_SIZE;
+    chunk_count_ = 0;
+    reserved_bytes_ = 0;
+    used_bytes_ = 0;
+}
+
+size_t IndexArena::GetChunkCount() const {
+    return chunk_count_;
+}
+
+size_t IndexArena::GetReservedBytes() const {
+    return reserved_bytes_;
+}
+
+size_t IndexArena::GetUsedBytes() const {
+    return used_bytes_;
+}
+
+size_t IndexArena::GetBlockSize(size_t bytes, size_t alignment) {
+    if (bytes <= MAX_POOLED_SIZE && alignment <= SIZE_CLASS) {
+        return bytes == 0 ? SIZE_CLASS : (bytes - 1) / SIZE_CLASS * SIZE_CLASS + SIZE_CLASS;
+    }
+    return bytes;
+}
+
+void* IndexArena::do_allocate(size_t bytes, size_t alignment) {
+    used_bytes_ += GetBlockSize(bytes, alignment);
+    if (bytes <= MAX_POOLED_SIZE && alignment <= SIZE_CLASS) {
+        const size_t size_class = bytes == 0 ? 0 : (bytes - 1) / SIZE_CLASS;
+        if (FreeBlock* block = free_lists_[size_class]) {
+            free_lists_[size_class] = block->next;
+            return block;
+        }
+        const size_t size = (size_class + 1) * SIZE_CLASS;
+        if (static_cast<size_t>(chunk_end_ - chunk_position_) < size) {
+            AddChunk(size);
+        }
+        void* block = chunk_position_;
+        chunk_position_ += size;
+        return block;
+    }
+
+    const size_t large_alignment = GetLargeAlignment(alignment);
+    const size_t size = GetLargeHeaderSize(alignment) + bytes;
+    auto* large_block = static_cast<LargeBlock*>(::operator new(size, std::align_val_t(large_alignment)));
+    *large_block = {nullptr, large_blocks_, size, large_alignment};
+    if (large_blocks_) {
+        large_blocks_->prev = large_block;
+    }
+    large_blocks_ = large_block;
+    ++chunk_count_;
+    reserved_bytes_ += size;
+    return reinterpret_cast<char*>(large_block) + GetLargeHeaderSize(alignment);
+}
+
+void IndexArena::do_deallocate(void* block, size_t bytes, size_t alignment) {
+    used_bytes_ -= GetBlockSize(bytes, alignment);
+    if (bytes <= MAX_POOLED_SIZE && alignment <= SIZE_CLASS) {
+        const size_t size_class = bytes == 0 ? 0 : (bytes - 1) / SIZE_CLASS;
+        auto* free_block = static_cast<FreeBlock*>(block);
+        free_block->next = free_lists_[size_class];
+        free_lists_[size_class] = free_block;
+        return;
+    }
+
+    auto* large_block = reinterpret_cast<LargeBlock*>(static_cast<char*>(block) - GetLargeHeaderSize(alignment));
+    if (large_block->prev) {
+        large_block->prev->next = large_block->next;
+    } else {
+        large_blocks_ = large_block->next;
+    }
+    if (large_block->next) {
+        large_block->next->prev = large_block->prev;
+    }
+    --chunk_count_;
+    reserved_bytes_ -= large_block->size;
+    ::operator delete(large_block, std::align_val_t(large_block->alignment));
+}
+
+bool IndexArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void IndexArena::AddChunk(size_t min_size) {
+    // the rest of the current chunk is left unused
+    const size_t size = std::max(next_chunk_size_, sizeof(Chunk) + min_size);
+    auto* chunk = static_cast<Chunk*>(::operator new(size));
+    *chunk = {chunks_, size};
+    chunks_ = chunk;
+    chunk_position_ = reinterpret_cast<char*>(chunk) + sizeof(Chunk);
+    chunk_end_ = reinterpret_cast<char*>(chunk) + size;
+    next_chunk_size_ = std::min(next_chunk_size_ * 2, MAX_CHUNK_SIZE);
+    ++chunk_count_;
+    reserved_bytes_ += size;
+}
+
+size_t IndexArena::GetLargeHeaderSize(size_t alignment) {
+    const size_t large_alignment = GetLargeAlignment(alignment);
+    return (sizeof(LargeBlock) + large_alignment - 1) / large_alignment * large_alignment;
+}
+
+size_t IndexArena::GetLargeAlignment(size_t alignment) {
+    return std::max(alignment, alignof(std::max_align_t));
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+// Memory resource for the nodes of the index. Blocks up to
+// MAX_POOLED_SIZE bytes are cut from chunks of growing size, and freed
+// blocks go to a free list of their size class for reuse, so building
+// an index takes one operator new per chunk instead of one per node.
+// Larger blocks are allocated one by one. All of the memory is freed
+// with the arena, containers using it may be left without destruction.
+// The arena isn't synchronized
+class IndexArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t MAX_POOLED_SIZE = 512;
+
+    IndexArena() = default;
+    IndexArena(const IndexArena&) = delete;
+    IndexArena& operator=(const IndexArena&) = delete;
+    ~IndexArena() override;
+
+    // Frees all the blocks at once
+    void Release();
+
+    // Chunks and large blocks taken from operator new and their bytes
+    size_t GetChunkCount() const;
+    size_t GetReservedBytes() const;
+    // Bytes of the blocks given out and not freed, in their size classes;
+    // the rest of the reserved bytes are free blocks, unused tails of
+    // chunks and headers
+    size_t GetUsedBytes() const;
+
+    // Bytes a block takes out of the arena as counted by GetUsedBytes
+    static size_t GetBlockSize(size_t bytes, size_t alignment);
+
+private:
+    static constexpr size_t SIZE_CLASS = 16;
+    static constexpr size_t FIRST_CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    // Header at the start of a chunk
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    // Header in front of a large block
+    struct LargeBlock {
+        LargeBlock* prev;
+        LargeBlock* next;
+        size_t size;
+        size_t alignment;
+    };
+
+    std::array<FreeBlock*, MAX_POOLED_SIZE / SIZE_CLASS> free_lists_{};
+    Chunk* chunks_ = nullptr;
+    char* chunk_position_ = nullptr;
+    char* chunk_end_ = nullptr;
+    size_t next_chunk_size_ = FIRST_CHUNK_SIZE;
+    LargeBlock* large_blocks_ = nullptr;
+    size_t chunk_count_ = 0;
+    size_t reserved_bytes_ = 0;
+    size_t used_bytes_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* block, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    void AddChunk(size_t min_size);
+    static size_t GetLargeHeaderSize(size_t alignment);
+    static size_t GetLargeAlignment(size_t alignment);
+};
@@ -0,0 +1,61 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LatencyHistogram::AddTo(Counts& counts) const {
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] += counts_[i].load(std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::ToIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+    const int highest_bit = 63 - __builtin_clzll(value);
+    if (highest_bit >= MAX_VALUE_BITS) {
+        return BUCKET_COUNT - 1;
+    }
+    const int shift = highest_bit - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::ToUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int shift = static_cast<int>(index / SUB_BUCKET_COUNT) - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::ComputeTotal(const Counts& counts) {
+    uint64_t total = 0;
+    for (const uint64_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::ComputePercentile(const Counts& counts, double percentile) {
+    const uint64_t total = ComputeTotal(counts);
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(total * percentile / 100.0)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return ToUpperBound(i);
+        }
+    }
+    return ToUpperBound(BUCKET_COUNT - 1);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram in the spirit of HdrHistogram: every power of two
+// is split into 2^SUB_BUCKET_BITS equal buckets, so a recorded value is
+// known with relative error below 1 / 2^SUB_BUCKET_BITS. Values below
+// 2^SUB_BUCKET_BITS are exact, values from 2^MAX_VALUE_BITS go to the
+// last bucket. Recording is a single relaxed atomic increment, so one
+// histogram can be shared by many threads.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int MAX_VALUE_BITS = 40;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    using Counts = std::array<uint64_t, BUCKET_COUNT>;
+
+    void Record(uint64_t value) {
+        counts_[ToIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Adds counts of this histogram to counts
+    void AddTo(Counts& counts) const;
+
+    void Reset();
+
+    static size_t ToIndex(uint64_t value);
+
+    // The greatest value which goes to the bucket
+    static uint64_t ToUpperBound(size_t index);
+
+    static uint64_t ComputeTotal(const Counts& counts);
+
+    // Value at percentile (0, 100] or zero for empty counts
+    static uint64_t ComputePercentile(const Counts& counts, double percentile);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+};
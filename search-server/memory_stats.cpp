@@ -0,0 +1,105 @@
+#include "memory_stats.h"
+
+#include <iomanip>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+// three links and a color besides the value
+size_t GetTreeNodeBytes(size_t value_size) {
+    return 3 * sizeof(void*) + sizeof(int) + (sizeof(void*) - sizeof(int)) + value_size;
+}
+
+} // namespace
+
+size_t IndexMemoryStats::GetTotalBytes() const {
+    return term_dictionary.GetTotalBytes()
+        + prefix_dictionary.GetTotalBytes()
+        + postings.GetTotalBytes()
+        + impact_index.GetTotalBytes()
+        + forward_index.GetTotalBytes()
+        + positions.GetTotalBytes()
+        + documents.GetTotalBytes()
+        + stop_words.GetTotalBytes()
+        + duplicate_fingerprints.GetTotalBytes()
+        + index_arena.GetUnusedBytes();
+}
+
+void PrintMemoryStats(std::ostream& out, const IndexMemoryStats& stats) {
+    const auto print_usage = [&out](const std::string& name, const MemoryUsage& usage) {
+        out << std::left << std::setw(24) << name << std::right
+            << std::setw(12) << usage.entries
+            << std::setw(14) << usage.payload_bytes
+            << std::setw(14) << usage.overhead_bytes
+            << std::setw(14) << usage.GetTotalBytes() << '\n';
+    };
+    out << std::left << std::setw(24) << "part"s << std::right << std::setw(12) << "entries"s
+        << std::setw(14) << "payload"s << std::setw(14) << "overhead"s << std::setw(14) << "total"s << '\n';
+    print_usage("term dictionary"s, stats.term_dictionary);
+    print_usage("prefix dictionary"s, stats.prefix_dictionary);
+    print_usage("postings"s, stats.postings);
+    print_usage("impact index"s, stats.impact_index);
+    print_usage("forward index"s, stats.forward_index);
+    print_usage("positions"s, stats.positions);
+    print_usage("documents"s, stats.documents);
+    print_usage("stop words"s, stats.stop_words);
+    print_usage("duplicate fingerprints"s, stats.duplicate_fingerprints);
+    out << "index arena: "s << stats.index_arena.chunk_count << " chunks, "s
+        << stats.index_arena.reserved_bytes << " bytes reserved, "s
+        << stats.index_arena.used_bytes << " in use, "s
+        << stats.index_arena.GetUnusedBytes() << " unused\n"s;
+    out << "total bytes: "s << stats.GetTotalBytes() << '\n';
+    out << "posting list lengths:"s;
+    for (size_t i = 0; i < stats.posting_length_histogram.size(); ++i) {
+        if (stats.posting_length_histogram[i] == 0) {
+            continue;
+        }
+        if (i == 0) {
+            out << " [0]="s;
+        } else {
+            out << " ["s << (size_t(1) << (i - 1)) << ", "s << (size_t(1) << i) << ")="s;
+        }
+        out << stats.posting_length_histogram[i];
+    }
+    out << '\n';
+}
+
+size_t EstimateAllocationSize(size_t requested) {
+    if (requested == 0) {
+        return 0;
+    }
+    const size_t size = (requested + 8 + 15) / 16 * 16;
+    return size < 32 ? 32 : size;
+}
+
+size_t EstimateTreeNodeSize(size_t value_size) {
+    return EstimateAllocationSize(GetTreeNodeBytes(value_size));
+}
+
+size_t EstimateStringHeapSize(const std::string& str) {
+    const size_t short_capacity = std::string().capacity();
+    return str.capacity() > short_capacity ? EstimateAllocationSize(str.capacity() + 1) : 0;
+}
+
+size_t EstimateArenaAllocationSize(size_t requested) {
+    return requested == 0 ? 0 : IndexArena::GetBlockSize(requested, alignof(void*));
+}
+
+size_t EstimateArenaTreeNodeSize(size_t value_size) {
+    return EstimateArenaAllocationSize(GetTreeNodeBytes(value_size));
+}
+
+size_t EstimateArenaStringHeapSize(const std::pmr::string& str) {
+    const size_t short_capacity = std::pmr::string().capacity();
+    return str.capacity() > short_capacity ? EstimateArenaAllocationSize(str.capacity() + 1) : 0;
+}
+
+size_t GetPostingLengthBucket(size_t length) {
+    size_t bucket = 0;
+    while (length > 0) {
+        length >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
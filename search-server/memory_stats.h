@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "index_arena.h"
+
+// Memory of one part of the index. payload_bytes is the data itself,
+// overhead_bytes are estimated object headers, tree node links and
+// allocator bookkeeping on top of it
+struct MemoryUsage {
+    size_t entries = 0;
+    size_t payload_bytes = 0;
+    size_t overhead_bytes = 0;
+
+    size_t GetTotalBytes() const {
+        return payload_bytes + overhead_bytes;
+    }
+};
+
+// Chunks and large blocks of an IndexArena, the bytes reserved from
+// operator new and the bytes of the blocks in use
+struct ArenaUsage {
+    size_t chunk_count = 0;
+    size_t reserved_bytes = 0;
+    size_t used_bytes = 0;
+
+    // free blocks, unused tails of chunks and headers
+    size_t GetUnusedBytes() const {
+        return reserved_bytes - used_bytes;
+    }
+};
+
+struct IndexMemoryStats {
+    MemoryUsage term_dictionary;
+    // front coded copy of the words for prefix queries, once built
+    MemoryUsage prefix_dictionary;
+    MemoryUsage postings;
+    // impact-ordered copy of the postings, once built
+    MemoryUsage impact_index;
+    MemoryUsage forward_index;
+    // position lists of the positional index, one per word of a document
+    MemoryUsage positions;
+    MemoryUsage documents;
+    MemoryUsage stop_words;
+    MemoryUsage duplicate_fingerprints;
+    // arena of the term dictionary, the postings and the documents: the
+    // blocks in use are counted with these parts, the total adds the
+    // unused bytes only
+    ArenaUsage index_arena;
+    // [0] counts empty posting lists, [i] counts lists with
+    // length in [2^(i-1), 2^i)
+    std::vector<size_t> posting_length_histogram;
+
+    size_t GetTotalBytes() const;
+};
+
+void PrintMemoryStats(std::ostream& out, const IndexMemoryStats& stats);
+
+// Estimates for the default allocator: every allocation has an 8 byte
+// header and is rounded up to 16 bytes, with 32 bytes at least (glibc).
+// Nothing is allocated for zero bytes, as by empty containers
+size_t EstimateAllocationSize(size_t requested);
+
+// Bytes allocated for one node of std::map/std::set with the value type
+// of the given size: three links and a color besides the value
+size_t EstimateTreeNodeSize(size_t value_size);
+
+// Bytes allocated outside of the string object; short strings are
+// stored inside the object
+size_t EstimateStringHeapSize(const std::string& str);
+
+// Estimates for containers in an IndexArena: pooled blocks are rounded
+// up to the size classes of the arena without a header, the headers of
+// chunks and large blocks are counted by the arena itself
+size_t EstimateArenaAllocationSize(size_t requested);
+size_t EstimateArenaTreeNodeSize(size_t value_size);
+size_t EstimateArenaStringHeapSize(const std::pmr::string& str);
+
+size_t GetPostingLengthBucket(size_t length);
@@ -0,0 +1,167 @@
+#include "near_duplicates.h"
+
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// Minimums of signature_size hash functions of the term ids, the high
+// half of every hash is enough for the estimate
+void ComputeSignature(const WordFrequencies& word_freqs, uint32_t* signature, size_t signature_size) {
+    std::fill(signature, signature + signature_size, std::numeric_limits<uint32_t>::max());
+    for (auto it = word_freqs.begin(); it != word_freqs.end(); ++it) {
+        const uint64_t term_hash = Mix(it.GetTermId());
+        for (size_t i = 0; i < signature_size; ++i) {
+            signature[i] = std::min(signature[i], static_cast<uint32_t>(Mix(term_hash + i * 0x9e3779b97f4a7c15ULL) >> 32));
+        }
+    }
+}
+
+double ComputeJaccard(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        const std::string_view lhs_word = (*lhs_it).first;
+        const std::string_view rhs_word = (*rhs_it).first;
+        if (lhs_word < rhs_word) {
+            ++lhs_it;
+        } else if (rhs_word < lhs_word) {
+            ++rhs_it;
+        } else {
+            ++common;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
+
+}  // namespace
+
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server,
+                                                 const NearDuplicateOptions& options) {
+    if (options.bands <= 0 || options.rows <= 0) {
+        throw std::invalid_argument("Count of bands and rows must be positive"s);
+    }
+    if (options.max_bucket_size <= 1) {
+        throw std::invalid_argument("Size of compared buckets must be at least 2"s);
+    }
+    if (!search_server.HasForwardIndex()) {
+        throw std::invalid_argument("Near duplicates are searched with the forward index"s);
+    }
+    const std::vector<int> ids(search_server.begin(), search_server.end());
+    const size_t bands = options.bands;
+    const size_t rows = options.rows;
+    const size_t signature_size = bands * rows;
+    const size_t max_bucket_size = options.max_bucket_size;
+
+    // signatures of all documents in one buffer
+    std::vector<size_t> indexes(ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::vector<uint32_t> signatures(ids.size() * signature_size);
+    std::for_each(std::execution::par,
+                  indexes.begin(), indexes.end(),
+                  [&search_server, &ids, &signatures, signature_size](size_t index) {
+                      ComputeSignature(search_server.GetWordFrequencies(ids[index]),
+                                       signatures.data() + index * signature_size, signature_size);
+                  });
+
+    // every band is sorted by its bucket separately, the members of a
+    // bucket are a run of documents in the order of ids
+    std::vector<std::vector<std::pair<size_t, size_t>>> band_candidates(bands);
+    std::vector<size_t> band_indexes(bands);
+    std::iota(band_indexes.begin(), band_indexes.end(), 0);
+    std::for_each(std::execution::par,
+                  band_indexes.begin(), band_indexes.end(),
+                  [&signatures, &band_candidates, rows, signature_size, max_bucket_size](size_t band) {
+                      const size_t document_count = signatures.size() / signature_size;
+                      std::vector<std::pair<uint64_t, size_t>> buckets(document_count);
+                      for (size_t index = 0; index < document_count; ++index) {
+                          uint64_t bucket = band;
+                          const uint32_t* signature = signatures.data() + index * signature_size;
+                          for (size_t row = band * rows; row < (band + 1) * rows; ++row) {
+                              bucket = Mix(bucket ^ signature[row]);
+                          }
+                          buckets[index] = {bucket, index};
+                      }
+                      std::sort(buckets.begin(), buckets.end());
+                      auto& candidates = band_candidates[band];
+                      for (auto first = buckets.begin(); first != buckets.end();) {
+                          const auto last = std::find_if(first, buckets.end(), [first](const auto& bucket) {
+                              return bucket.first != first->first;
+                          });
+                          for (auto lhs = first; lhs != last && lhs - first < static_cast<ptrdiff_t>(max_bucket_size); ++lhs) {
+                              for (auto rhs = std::next(lhs); rhs != last; ++rhs) {
+                                  candidates.push_back({lhs->second, rhs->second});
+                              }
+                          }
+                          first = last;
+                      }
+                  });
+
+    std::vector<std::pair<size_t, size_t>> candidates;
+    for (const auto& band : band_candidates) {
+        candidates.insert(candidates.end(), band.begin(), band.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // estimated similarity only selects candidates, exact Jaccard decides
+    std::vector<char> is_similar(candidates.size());
+    std::transform(std::execution::par,
+                   candidates.begin(), candidates.end(),
+                   is_similar.begin(),
+                   [&search_server, &ids, &options](const std::pair<size_t, size_t>& candidate) {
+                       return ComputeJaccard(search_server.GetWordFrequencies(ids[candidate.first]),
+                                             search_server.GetWordFrequencies(ids[candidate.second]))
+                           >= options.jaccard_threshold;
+                   });
+
+    // groups are stars: candidates go by the smaller document, which
+    // takes its similar documents not taken yet unless it's taken itself
+    enum class Role : char {
+        NONE,
+        FIRST,
+        MEMBER,
+    };
+    std::vector<Role> roles(ids.size(), Role::NONE);
+    std::map<size_t, std::vector<int>> first_to_group;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const auto [first, member] = candidates[i];
+        if (!is_similar[i] || roles[first] == Role::MEMBER || roles[member] != Role::NONE) {
+            continue;
+        }
+        auto& group = first_to_group[first];
+        if (group.empty()) {
+            roles[first] = Role::FIRST;
+            group.push_back(ids[first]);
+        }
+        roles[member] = Role::MEMBER;
+        group.push_back(ids[member]);
+    }
+    std::vector<std::vector<int>> groups;
+    for (auto& [first, group] : first_to_group) {
+        groups.push_back(std::move(group));
+    }
+    return groups;
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options) {
+    for (const auto& group : FindNearDuplicates(search_server, options)) {
+        for (auto it = std::next(group.begin()); it != group.end(); ++it) {
+            search_server.RemoveDocument(*it);
+            std::cout << "Found near-duplicate document id "s << *it << std::endl;
+        }
+    }
+}
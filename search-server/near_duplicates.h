@@ -0,0 +1,33 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include "search_server.h"
+
+// Near-duplicate search by MinHash signatures and banded LSH tables.
+// Documents whose word sets have Jaccard similarity of at least
+// jaccard_threshold to a document fall into its group with high
+// probability, documents far below the threshold almost never get
+// compared.
+// Probability of two documents with similarity s to become candidates
+// is 1 - (1 - s^rows)^bands, so bands and rows should be chosen to put
+// the steep part of that curve below jaccard_threshold.
+struct NearDuplicateOptions {
+    double jaccard_threshold = 0.8;
+    int bands = 20;
+    int rows = 5;
+    // members of a bucket of a band are compared with each other; in a
+    // larger bucket they are compared with its first max_bucket_size
+    // documents only
+    int max_bucket_size = 64;
+};
+
+// Groups of near-duplicate documents, every group is sorted by id and
+// contains at least two documents. Groups are not transitive: every
+// document of a group is similar to the first one, the document with the
+// smallest id that isn't similar to a smaller one itself
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server,
+                                                 const NearDuplicateOptions& options = {});
+
+// Keeps the first document of every group
+void RemoveNearDuplicates(SearchServer& search_server,
+                          const NearDuplicateOptions& options = {});
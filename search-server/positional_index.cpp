@@ -0,0 +1,63 @@
+#include "positional_index.h"
+
+#include <algorithm>
+
+EncodedPositions EncodePositions(const std::vector<uint32_t>& positions) {
+    EncodedPositions encoded;
+    encoded.reserve(positions.size());
+    uint32_t previous = 0;
+    for (const uint32_t position : positions) {
+        uint32_t delta = position - previous;
+        previous = position;
+        while (delta >= 0x80) {
+            encoded.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        encoded.push_back(static_cast<uint8_t>(delta));
+    }
+    encoded.shrink_to_fit();
+    return encoded;
+}
+
+std::vector<uint32_t> DecodePositions(const EncodedPositions& encoded) {
+    std::vector<uint32_t> positions;
+    positions.reserve(encoded.size());
+    uint32_t position = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (const uint8_t byte : encoded) {
+        delta |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        position += delta;
+        positions.push_back(position);
+        delta = 0;
+        shift = 0;
+    }
+    return positions;
+}
+
+bool ContainsPhrase(const std::vector<std::vector<uint32_t>>& positions, int slop) {
+    if (positions.empty()) {
+        return true;
+    }
+    const uint64_t extra_words = positions.size() - 1;
+    for (const uint32_t first : positions.front()) {
+        // the earliest following positions give the shortest span
+        uint32_t last = first;
+        for (size_t i = 1; i < positions.size(); ++i) {
+            const auto it = std::upper_bound(positions[i].begin(), positions[i].end(), last);
+            if (it == positions[i].end()) {
+                // later starts can't find the word after them either
+                return false;
+            }
+            last = *it;
+        }
+        if (last - first - extra_words <= static_cast<uint64_t>(slop)) {
+            return true;
+        }
+    }
+    return false;
+}
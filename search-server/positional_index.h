@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Positions of a word in a document: differences between neighbouring
+// positions in ascending order, 7 bits per byte with the high bit set
+// on every byte but the last one of a number
+using EncodedPositions = std::vector<uint8_t>;
+
+EncodedPositions EncodePositions(const std::vector<uint32_t>& positions);
+
+std::vector<uint32_t> DecodePositions(const EncodedPositions& encoded);
+
+// True if there are positions p[0] < p[1] < ... taken from the lists in
+// their order with p.back() - p.front() - (lists.size() - 1) <= slop,
+// i.e. the words go in order with at most slop other words between them
+bool ContainsPhrase(const std::vector<std::vector<uint32_t>>& positions, int slop);
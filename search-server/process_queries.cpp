@@ -18,6 +18,23 @@ std::vector<std::vector<Document>> ProcessQueries(
     return documents;
 }
 
+std::vector<SearchResult> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const SearchBudget& budget)
+{
+    std::vector<SearchResult> results(queries.size());
+
+    std::transform(std::execution::par,
+                   queries.cbegin(), queries.cend(),
+                   results.begin(),
+                   [&search_server, &budget](const std::string& query) {
+                       return search_server.FindTopDocuments(query, budget);
+                   });
+
+    return results;
+}
+
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries)
@@ -12,6 +12,12 @@ std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+// Every query gets the budget, a deadline is common to all of them
+std::vector<SearchResult> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const SearchBudget& budget);
+
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
@@ -0,0 +1,124 @@
+#include "query_client.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "wire_format.h"
+
+using std::literals::string_literals::operator""s;
+
+QueryClient::QueryClient(const std::string& unix_socket_path) {
+    sockaddr_un address{};
+    if (unix_socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long"s);
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, unix_socket_path.c_str());
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        const std::string error = std::strerror(errno);
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw std::runtime_error("Can't connect to "s + unix_socket_path + ": "s + error);
+    }
+}
+
+QueryClient::QueryClient(uint16_t tcp_port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(tcp_port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        const std::string error = std::strerror(errno);
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw std::runtime_error("Can't connect to port "s + std::to_string(tcp_port) + ": "s + error);
+    }
+    const int enable = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+uint64_t QueryClient::Send(QueryRequest request) {
+    request.id = next_id_++;
+    AppendFrame(output_, EncodeRequest(request));
+    return request.id;
+}
+
+void QueryClient::Flush() {
+    WriteAll(fd_, output_);
+    output_.clear();
+}
+
+QueryResponse QueryClient::Receive() {
+    std::string message;
+    if (!ReadFrame(fd_, input_, message)) {
+        throw std::runtime_error("Server closed the connection"s);
+    }
+    return DecodeResponse(message);
+}
+
+std::vector<Document> QueryClient::FindTopDocuments(std::string_view raw_query, DocumentStatus status) {
+    QueryRequest request;
+    request.type = QueryRequestType::SEARCH;
+    request.text = raw_query;
+    request.status = status;
+    return Call(std::move(request)).documents;
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> QueryClient::MatchDocument(std::string_view raw_query,
+                                                                                int document_id) {
+    QueryRequest request;
+    request.type = QueryRequestType::MATCH;
+    request.text = raw_query;
+    request.document_id = document_id;
+    QueryResponse response = Call(std::move(request));
+    return {std::move(response.words), response.status};
+}
+
+void QueryClient::AddDocument(int document_id, std::string_view document,
+                              DocumentStatus status, const std::vector<int>& ratings) {
+    QueryRequest request;
+    request.type = QueryRequestType::ADD_DOCUMENT;
+    request.document_id = document_id;
+    request.text = document;
+    request.status = status;
+    request.ratings = ratings;
+    Call(std::move(request));
+}
+
+void QueryClient::RemoveDocument(int document_id) {
+    QueryRequest request;
+    request.type = QueryRequestType::REMOVE_DOCUMENT;
+    request.document_id = document_id;
+    Call(std::move(request));
+}
+
+QueryResponse QueryClient::Call(QueryRequest request) {
+    const uint64_t id = Send(std::move(request));
+    Flush();
+    while (true) {
+        QueryResponse response = Receive();
+        // responses to earlier pipelined requests are skipped
+        if (response.id != id) {
+            continue;
+        }
+        if (response.is_error) {
+            throw std::invalid_argument(response.error);
+        }
+        return response;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "query_protocol.h"
+
+// Blocking client of QueryServer. Send only buffers a request, so
+// several requests may be pipelined before Flush and Receive; the
+// other methods send one request and wait for its response
+class QueryClient {
+public:
+    // Connects to a Unix socket, throws std::runtime_error on failure
+    explicit QueryClient(const std::string& unix_socket_path);
+    // Connects to a port of the loopback interface
+    explicit QueryClient(uint16_t tcp_port);
+    ~QueryClient();
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    // Returns the id given to the request
+    uint64_t Send(QueryRequest request);
+    void Flush();
+    // Responses come in the order the server completes requests
+    QueryResponse Receive();
+
+    // Throw std::invalid_argument with the error of the server
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL);
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id);
+    void AddDocument(int document_id, std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+private:
+    int fd_ = -1;
+    uint64_t next_id_ = 0;
+    std::string output_;
+    std::string input_;
+
+    QueryResponse Call(QueryRequest request);
+};
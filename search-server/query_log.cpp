@@ -0,0 +1,30 @@
+#include "query_log.h"
+
+#include <stdexcept>
+
+using std::literals::string_literals::operator""s;
+
+void WriteQueryLogRecord(std::ostream& out, const QueryLogRecord& record) {
+    out << record.offset_us << '\t' << record.results << '\t' << record.query << '\n';
+}
+
+std::vector<QueryLogRecord> ReadQueryLog(std::istream& in) {
+    std::vector<QueryLogRecord> records;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        const size_t first_tab = line.find('\t');
+        const size_t second_tab = first_tab == std::string::npos ? first_tab : line.find('\t', first_tab + 1);
+        if (second_tab == std::string::npos) {
+            throw std::invalid_argument("Malformed query log line: "s + line);
+        }
+        QueryLogRecord record;
+        record.offset_us = std::stoull(line.substr(0, first_tab));
+        record.results = std::stoull(line.substr(first_tab + 1, second_tab - first_tab - 1));
+        record.query = line.substr(second_tab + 1);
+        records.push_back(std::move(record));
+    }
+    return records;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One search request of a query log: time since the start of logging,
+// count of found documents and the raw query. A record is written as
+// a line "<offset_us>\t<results>\t<query>"
+struct QueryLogRecord {
+    uint64_t offset_us = 0;
+    size_t results = 0;
+    std::string query;
+};
+
+void WriteQueryLogRecord(std::ostream& out, const QueryLogRecord& record);
+
+// Throws std::invalid_argument on a malformed line
+std::vector<QueryLogRecord> ReadQueryLog(std::istream& in);
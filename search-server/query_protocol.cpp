@@ -0,0 +1,173 @@
+#include "query_protocol.h"
+
+#include <stdexcept>
+
+#include "wire_format.h"
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+// a message is decoded entirely, trailing bytes mean a malformed frame
+void ThrowIfNotAtEnd(const WireReader& reader) {
+    if (!reader.IsAtEnd()) {
+        throw std::invalid_argument("Unexpected bytes at the end of a message"s);
+    }
+}
+
+}  // namespace
+
+bool IsWriteRequest(QueryRequestType type) {
+    return type == QueryRequestType::ADD_DOCUMENT || type == QueryRequestType::REMOVE_DOCUMENT;
+}
+
+std::string EncodeRequest(const QueryRequest& request) {
+    WireWriter writer;
+    writer.WriteUint(request.id);
+    writer.WriteUint(static_cast<uint64_t>(request.type));
+    switch (request.type) {
+    case QueryRequestType::SEARCH:
+        writer.WriteString(request.text);
+        WriteStatus(writer, request.status);
+        break;
+    case QueryRequestType::MATCH:
+        writer.WriteString(request.text);
+        writer.WriteInt(request.document_id);
+        break;
+    case QueryRequestType::ADD_DOCUMENT:
+        writer.WriteInt(request.document_id);
+        writer.WriteString(request.text);
+        WriteStatus(writer, request.status);
+        writer.WriteUint(request.ratings.size());
+        for (const int rating : request.ratings) {
+            writer.WriteInt(rating);
+        }
+        break;
+    case QueryRequestType::REMOVE_DOCUMENT:
+        writer.WriteInt(request.document_id);
+        break;
+    }
+    return writer.Release();
+}
+
+QueryRequest DecodeRequest(std::string_view message) {
+    WireReader reader(message);
+    QueryRequest request;
+    request.id = reader.ReadUint();
+    const uint64_t type = reader.ReadUint();
+    if (type > static_cast<uint64_t>(QueryRequestType::REMOVE_DOCUMENT)) {
+        throw std::invalid_argument("Unknown request type "s + std::to_string(type));
+    }
+    request.type = static_cast<QueryRequestType>(type);
+    switch (request.type) {
+    case QueryRequestType::SEARCH:
+        request.text = reader.ReadString();
+        request.status = ReadStatus(reader);
+        break;
+    case QueryRequestType::MATCH:
+        request.text = reader.ReadString();
+        request.document_id = static_cast<int>(reader.ReadInt());
+        break;
+    case QueryRequestType::ADD_DOCUMENT: {
+        request.document_id = static_cast<int>(reader.ReadInt());
+        request.text = reader.ReadString();
+        request.status = ReadStatus(reader);
+        const uint64_t rating_count = reader.ReadUint();
+        for (uint64_t i = 0; i < rating_count; ++i) {
+            request.ratings.push_back(static_cast<int>(reader.ReadInt()));
+        }
+        break;
+    }
+    case QueryRequestType::REMOVE_DOCUMENT:
+        request.document_id = static_cast<int>(reader.ReadInt());
+        break;
+    }
+    ThrowIfNotAtEnd(reader);
+    return request;
+}
+
+std::string EncodeResponse(const QueryResponse& response) {
+    WireWriter writer;
+    writer.WriteUint(response.id);
+    writer.WriteUint(response.is_error);
+    if (response.is_error) {
+        writer.WriteString(response.error);
+        return writer.Release();
+    }
+    writer.WriteUint(response.documents.size());
+    for (const Document& document : response.documents) {
+        writer.WriteInt(document.id);
+        writer.WriteDouble(document.relevance);
+        writer.WriteInt(document.rating);
+    }
+    writer.WriteUint(response.words.size());
+    for (const std::string& word : response.words) {
+        writer.WriteString(word);
+    }
+    WriteStatus(writer, response.status);
+    writer.WriteUint(response.is_partial);
+    return writer.Release();
+}
+
+QueryResponse DecodeResponse(std::string_view message) {
+    WireReader reader(message);
+    QueryResponse response;
+    response.id = reader.ReadUint();
+    response.is_error = reader.ReadUint() != 0;
+    if (response.is_error) {
+        response.error = reader.ReadString();
+        ThrowIfNotAtEnd(reader);
+        return response;
+    }
+    const uint64_t document_count = reader.ReadUint();
+    for (uint64_t i = 0; i < document_count; ++i) {
+        Document document;
+        document.id = static_cast<int>(reader.ReadInt());
+        document.relevance = reader.ReadDouble();
+        document.rating = static_cast<int>(reader.ReadInt());
+        response.documents.push_back(document);
+    }
+    const uint64_t word_count = reader.ReadUint();
+    for (uint64_t i = 0; i < word_count; ++i) {
+        response.words.push_back(std::string(reader.ReadString()));
+    }
+    response.status = ReadStatus(reader);
+    response.is_partial = reader.ReadUint() != 0;
+    ThrowIfNotAtEnd(reader);
+    return response;
+}
+
+QueryResponse ExecuteRequest(SearchServer& search_server, const QueryRequest& request,
+                             const std::optional<SearchBudget>& search_budget) {
+    QueryResponse response;
+    response.id = request.id;
+    try {
+        switch (request.type) {
+        case QueryRequestType::SEARCH:
+            if (search_budget) {
+                SearchResult result = search_server.FindTopDocuments(request.text, request.status, *search_budget);
+                response.documents = std::move(result.documents);
+                response.is_partial = result.is_partial;
+            } else {
+                response.documents = search_server.FindTopDocuments(request.text, request.status);
+            }
+            break;
+        case QueryRequestType::MATCH: {
+            const auto [words, status] = search_server.MatchDocument(request.text, request.document_id);
+            response.words.assign(words.begin(), words.end());
+            response.status = status;
+            break;
+        }
+        case QueryRequestType::ADD_DOCUMENT:
+            search_server.AddDocument(request.document_id, request.text, request.status, request.ratings);
+            break;
+        case QueryRequestType::REMOVE_DOCUMENT:
+            search_server.RemoveDocument(request.document_id);
+            break;
+        }
+    } catch (const std::exception& e) {
+        response.is_error = true;
+        response.error = e.what();
+    }
+    return response;
+}
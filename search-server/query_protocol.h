@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Requests and responses of the query server. Every message is one
+// frame of wire_format.h; responses carry the id of their request, so
+// a client may send many requests without waiting for responses
+enum class QueryRequestType {
+    SEARCH,
+    MATCH,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+};
+
+struct QueryRequest {
+    uint64_t id = 0;
+    QueryRequestType type = QueryRequestType::SEARCH;
+    // query of SEARCH and MATCH, text of ADD_DOCUMENT
+    std::string text;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct QueryResponse {
+    uint64_t id = 0;
+    bool is_error = false;
+    std::string error;
+    std::vector<Document> documents;
+    std::vector<std::string> words;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    // a search ran out of its budget, see SearchResult
+    bool is_partial = false;
+};
+
+bool IsWriteRequest(QueryRequestType type);
+
+std::string EncodeRequest(const QueryRequest& request);
+QueryRequest DecodeRequest(std::string_view message);
+
+std::string EncodeResponse(const QueryResponse& response);
+QueryResponse DecodeResponse(std::string_view message);
+
+// Errors of the search server are returned in the response. A search
+// with a budget may return a partial result
+QueryResponse ExecuteRequest(SearchServer& search_server, const QueryRequest& request,
+                             const std::optional<SearchBudget>& search_budget = std::nullopt);
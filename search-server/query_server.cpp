@@ -0,0 +1,434 @@
+#include "query_server.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#include "wire_format.h"
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+// epoll data of the descriptors which aren't connections
+const uint64_t LISTEN_ID = UINT64_MAX;
+const uint64_t WAKE_ID = UINT64_MAX - 1;
+
+std::runtime_error MakeSystemError(const std::string& what) {
+    return std::runtime_error(what + ": "s + std::strerror(errno));
+}
+
+QueryResponse MakeOverloadResponse(uint64_t request_id) {
+    QueryResponse response;
+    response.id = request_id;
+    response.is_error = true;
+    response.error = "Server is overloaded"s;
+    return response;
+}
+
+}  // namespace
+
+QueryServer::QueryServer(SearchServer& search_server, QueryServerOptions options)
+    : search_server_(search_server)
+    , options_(std::move(options))
+    , admission_(options_.admission) {
+    try {
+        if (!options_.unix_socket_path.empty()) {
+            sockaddr_un address{};
+            if (options_.unix_socket_path.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error("Socket path is too long"s);
+            }
+            address.sun_family = AF_UNIX;
+            std::strcpy(address.sun_path, options_.unix_socket_path.c_str());
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listen_fd_ < 0) {
+                throw MakeSystemError("Can't create a socket"s);
+            }
+            unlink(address.sun_path);
+            if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                throw MakeSystemError("Can't bind "s + options_.unix_socket_path);
+            }
+        } else {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(options_.tcp_port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listen_fd_ < 0) {
+                throw MakeSystemError("Can't create a socket"s);
+            }
+            const int enable = 1;
+            setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                throw MakeSystemError("Can't bind port "s + std::to_string(options_.tcp_port));
+            }
+            socklen_t length = sizeof(address);
+            getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+            port_ = ntohs(address.sin_port);
+        }
+        if (listen(listen_fd_, SOMAXCONN) != 0) {
+            throw MakeSystemError("Can't listen"s);
+        }
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            throw MakeSystemError("Can't create the event loop"s);
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = LISTEN_ID;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+        event.data.u64 = WAKE_ID;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+    } catch (...) {
+        for (const int fd : {listen_fd_, epoll_fd_, wake_fd_}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw;
+    }
+
+    for (size_t i = 0; i < std::max<size_t>(1, options_.worker_count); ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+    {
+        std::lock_guard guard(tasks_mutex_);
+        is_workers_stopped_ = true;
+    }
+    tasks_condition_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    for (const auto& [_, connection] : connections_) {
+        close(connection.fd);
+    }
+    close(listen_fd_);
+    close(epoll_fd_);
+    close(wake_fd_);
+    if (!options_.unix_socket_path.empty()) {
+        unlink(options_.unix_socket_path.c_str());
+    }
+}
+
+uint16_t QueryServer::GetPort() const {
+    return port_;
+}
+
+const AdmissionController& QueryServer::GetAdmissionController() const {
+    return admission_;
+}
+
+void QueryServer::Run() {
+    epoll_event events[256];
+    while (!is_stopped_.load()) {
+        const int count = epoll_wait(epoll_fd_, events, std::size(events), -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw MakeSystemError("Event loop failed"s);
+        }
+        for (int i = 0; i < count; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                Accept();
+            } else if (id == WAKE_ID) {
+                uint64_t value;
+                [[maybe_unused]] const ssize_t result = read(wake_fd_, &value, sizeof(value));
+                TakeCompletions();
+            } else {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    ReadConnection(id);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    WriteConnection(id);
+                }
+            }
+        }
+        Dispatch();
+    }
+}
+
+void QueryServer::Stop() {
+    is_stopped_.store(true);
+    Wake();
+}
+
+void QueryServer::Accept() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN when there are no more connections, other errors
+            // concern only the connection being accepted
+            return;
+        }
+        if (options_.unix_socket_path.empty()) {
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+        const uint64_t id = next_connection_id_++;
+        Connection& connection = connections_[id];
+        connection.fd = fd;
+        connection.events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection.events;
+        event.data.u64 = id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void QueryServer::ReadConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    char chunk[65536];
+    while (connection.pending_requests < options_.max_pending_requests
+           && connection.output.size() < options_.max_output_bytes) {
+        const ssize_t count = read(connection.fd, chunk, sizeof(chunk));
+        if (count == 0) {
+            CloseConnection(connection_id);
+            return;
+        }
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            CloseConnection(connection_id);
+            return;
+        }
+        connection.input.append(chunk, static_cast<size_t>(count));
+
+        std::string_view input = connection.input;
+        while (input.size() >= 4) {
+            uint32_t message_size = 0;
+            for (int i = 0; i < 4; ++i) {
+                message_size |= static_cast<uint32_t>(static_cast<uint8_t>(input[i])) << (8 * i);
+            }
+            if (message_size > options_.max_message_bytes) {
+                CloseConnection(connection_id);
+                return;
+            }
+            const size_t frame_size = GetFrameSize(input);
+            if (frame_size == 0) {
+                break;
+            }
+            QueryRequest request;
+            try {
+                request = DecodeRequest(GetFrameMessage(input.substr(0, frame_size)));
+            } catch (const std::invalid_argument&) {
+                // the stream can't be trusted after a malformed message
+                CloseConnection(connection_id);
+                return;
+            }
+            input.remove_prefix(frame_size);
+            if (!IsWriteRequest(request.type) && !admission_.TryEnter()) {
+                AppendFrame(connection.output, EncodeResponse(MakeOverloadResponse(request.id)));
+                continue;
+            }
+            queue_.push_back({connection_id, std::move(request), std::chrono::steady_clock::now()});
+            ++connection.pending_requests;
+        }
+        connection.input.erase(0, connection.input.size() - input.size());
+    }
+    UpdateEvents(connection_id);
+}
+
+void QueryServer::WriteConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        const ssize_t count = send(connection.fd, connection.output.data() + written,
+                                   connection.output.size() - written, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            CloseConnection(connection_id);
+            return;
+        }
+        written += static_cast<size_t>(count);
+    }
+    connection.output.erase(0, written);
+    UpdateEvents(connection_id);
+}
+
+void QueryServer::UpdateEvents(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    uint32_t events = 0;
+    // backpressure: a client that doesn't read its responses or sends
+    // faster than they are computed stops being read
+    if (connection.pending_requests < options_.max_pending_requests
+        && connection.output.size() < options_.max_output_bytes) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.events) {
+        connection.events = events;
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+}
+
+void QueryServer::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    // responses to its pending requests are dropped
+    connections_.erase(it);
+}
+
+void QueryServer::TakeCompletions() {
+    std::vector<CompletedBatch> completions;
+    {
+        std::lock_guard guard(completions_mutex_);
+        completions.swap(completions_);
+    }
+    std::unordered_set<uint64_t> connection_ids;
+    for (CompletedBatch& batch : completions) {
+        --running_batches_;
+        if (batch.is_write) {
+            is_write_running_ = false;
+        }
+        for (auto& [connection_id, frame] : batch.responses) {
+            const auto it = connections_.find(connection_id);
+            if (it == connections_.end()) {
+                continue;
+            }
+            it->second.output += frame;
+            --it->second.pending_requests;
+            connection_ids.insert(connection_id);
+        }
+    }
+    for (const uint64_t connection_id : connection_ids) {
+        WriteConnection(connection_id);
+    }
+}
+
+void QueryServer::Dispatch() {
+    std::vector<Batch> batches;
+    while (!queue_.empty() && !is_write_running_) {
+        if (IsWriteRequest(queue_.front().request.type)) {
+            if (running_batches_ + batches.size() > 0) {
+                break;
+            }
+            Batch batch;
+            batch.is_write = true;
+            batch.requests.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+            is_write_running_ = true;
+            batches.push_back(std::move(batch));
+            break;
+        }
+        // queued requests are spread over the workers
+        const size_t batch_size = std::clamp<size_t>((queue_.size() + workers_.size() - 1) / workers_.size(),
+                                                     1, options_.max_batch_size);
+        Batch batch;
+        while (!queue_.empty() && batch.requests.size() < batch_size
+               && !IsWriteRequest(queue_.front().request.type)) {
+            batch.requests.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        batches.push_back(std::move(batch));
+    }
+    if (batches.empty()) {
+        return;
+    }
+    running_batches_ += batches.size();
+    {
+        std::lock_guard guard(tasks_mutex_);
+        for (Batch& batch : batches) {
+            tasks_.push_back(std::move(batch));
+        }
+    }
+    tasks_condition_.notify_all();
+}
+
+void QueryServer::RunWorker() {
+    while (true) {
+        Batch batch;
+        {
+            std::unique_lock lock(tasks_mutex_);
+            tasks_condition_.wait(lock, [this] {
+                return is_workers_stopped_ || !tasks_.empty();
+            });
+            if (tasks_.empty()) {
+                return;
+            }
+            batch = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        // the loop never runs a write together with other batches
+        CompletedBatch completed;
+        completed.is_write = batch.is_write;
+        for (const PendingRequest& pending : batch.requests) {
+            std::string frame;
+            AppendFrame(frame, EncodeResponse(ExecuteAdmitted(pending)));
+            completed.responses.push_back({pending.connection_id, std::move(frame)});
+        }
+        {
+            std::lock_guard guard(completions_mutex_);
+            completions_.push_back(std::move(completed));
+        }
+        Wake();
+    }
+}
+
+QueryResponse QueryServer::ExecuteAdmitted(const PendingRequest& pending) {
+    if (IsWriteRequest(pending.request.type)) {
+        return ExecuteRequest(search_server_, pending.request);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const AdmissionDecision decision = admission_.Admit(now - pending.received_time, now,
+                                                        pending.request.type == QueryRequestType::SEARCH);
+    QueryResponse response;
+    if (decision == AdmissionDecision::SHED) {
+        response = MakeOverloadResponse(pending.request.id);
+    } else if (decision == AdmissionDecision::DEGRADE) {
+        SearchBudget budget;
+        budget.max_postings = admission_.GetOptions().degraded_max_postings;
+        response = ExecuteRequest(search_server_, pending.request, budget);
+    } else {
+        response = ExecuteRequest(search_server_, pending.request);
+    }
+    admission_.Leave();
+    return response;
+}
+
+void QueryServer::Wake() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t result = write(wake_fd_, &value, sizeof(value));
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "admission_controller.h"
+#include "query_protocol.h"
+#include "search_server.h"
+
+struct QueryServerOptions {
+    // Unix socket to listen on; loopback TCP port if empty
+    std::string unix_socket_path;
+    // 0 picks a free port, see QueryServer::GetPort
+    uint16_t tcp_port = 0;
+    size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    // requests handed to a worker at once
+    size_t max_batch_size = 64;
+    // a connection isn't read while it has this many requests without
+    // responses or this many bytes of responses not sent yet
+    size_t max_pending_requests = 1024;
+    size_t max_output_bytes = 4 << 20;
+    size_t max_message_bytes = 16 << 20;
+    // searches and matches are admitted by their queue delay, writes
+    // are never shed
+    AdmissionOptions admission;
+};
+
+// Serves requests of query_protocol.h with an epoll event loop in the
+// thread calling Run. Requests read in one iteration of the loop are
+// split into batches for a pool of workers. Searches run concurrently;
+// writes wait for the running batches and run alone, so every request
+// sees the writes received before it. Searches and matches pass the
+// admission control of AdmissionController: under overload they are
+// answered with an error or searched with a budget. The object must
+// outlive the thread calling Run
+class QueryServer {
+public:
+    // Binds the socket, throws std::runtime_error on failure
+    QueryServer(SearchServer& search_server, QueryServerOptions options);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    uint16_t GetPort() const;
+
+    // Serves requests until Stop is called
+    void Run();
+
+    // May be called from any thread and from a signal handler
+    void Stop();
+
+    // Counters of admission, see AdmissionController::WritePrometheus
+    const AdmissionController& GetAdmissionController() const;
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        size_t pending_requests = 0;
+        uint32_t events = 0;
+    };
+
+    struct PendingRequest {
+        uint64_t connection_id;
+        QueryRequest request;
+        std::chrono::steady_clock::time_point received_time;
+    };
+
+    struct Batch {
+        std::vector<PendingRequest> requests;
+        bool is_write = false;
+    };
+
+    struct CompletedBatch {
+        // connection id and the response frame
+        std::vector<std::pair<uint64_t, std::string>> responses;
+        bool is_write = false;
+    };
+
+    SearchServer& search_server_;
+    QueryServerOptions options_;
+    AdmissionController admission_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> is_stopped_ = false;
+
+    // state of the loop thread
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_ = 0;
+    std::deque<PendingRequest> queue_;
+    size_t running_batches_ = 0;
+    bool is_write_running_ = false;
+
+    std::mutex tasks_mutex_;
+    std::condition_variable tasks_condition_;
+    std::deque<Batch> tasks_;
+    bool is_workers_stopped_ = false;
+    std::vector<std::thread> workers_;
+
+    std::mutex completions_mutex_;
+    std::vector<CompletedBatch> completions_;
+
+    void Accept();
+    void ReadConnection(uint64_t connection_id);
+    void WriteConnection(uint64_t connection_id);
+    void UpdateEvents(uint64_t connection_id);
+    void CloseConnection(uint64_t connection_id);
+    void TakeCompletions();
+    void Dispatch();
+    void RunWorker();
+    QueryResponse ExecuteAdmitted(const PendingRequest& pending);
+    void Wake();
+};
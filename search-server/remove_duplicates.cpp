@@ -1,6 +1,18 @@
 #include "remove_duplicates.h"
 
 void RemoveDuplicates(SearchServer& search_server) {
+    // with duplicate tracking enabled the server already knows the duplicates
+    if (search_server.GetDuplicatePolicy() != DuplicatePolicy::IGNORE) {
+        for (const auto id : search_server.GetDuplicateDocuments()) {
+            search_server.RemoveDocument(id);
+            std::cout << "Found duplicate document id "s << id << std::endl;
+        }
+        return;
+    }
+    if (!search_server.HasForwardIndex()) {
+        throw std::invalid_argument("Duplicates are searched with the forward index"s);
+    }
+
     std::set<std::set<std::string_view>> tmp_str;
     std::vector<int> duplicates_id;
 
@@ -8,12 +8,12 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
     const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(result.size());
+    AddRequest(raw_query, result.size());
     return result;
 }
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
     const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(result.size());
+    AddRequest(raw_query, result.size());
     return result;
 }
 
@@ -21,7 +21,20 @@ int RequestQueue::GetNoResultRequests() const {
     return no_results_requests_;
 }
 
-void RequestQueue::AddRequest(int results_num) {
+void RequestQueue::SetQueryLog(std::ostream* query_log) {
+    query_log_ = query_log;
+    log_start_time_ = std::chrono::steady_clock::now();
+}
+
+void RequestQueue::AddRequest(const std::string& raw_query, int results_num) {
+    if (query_log_) {
+        const auto offset = std::chrono::steady_clock::now() - log_start_time_;
+        WriteQueryLogRecord(*query_log_, {
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(offset).count()),
+            static_cast<size_t>(results_num),
+            raw_query
+        });
+    }
     // new request - new second
     ++current_time_;
     // delete all the search results that we have arranged
@@ -1,6 +1,9 @@
 #pragma once
 #include "search_server.h"
+#include "query_log.h"
+#include <chrono>
 #include <deque>
+#include <ostream>
 
 class RequestQueue {
 public:
@@ -15,6 +18,10 @@ public:
 
     int GetNoResultRequests() const;
 
+    // Writes every following request to the log, which can be replayed
+    // by the load generator. nullptr stops logging
+    void SetQueryLog(std::ostream* query_log);
+
 private:
     struct QueryResult {
         uint64_t timestamp;
@@ -26,13 +33,15 @@ private:
     int no_results_requests_;
     uint64_t current_time_;
     const static int min_in_day_ = 1440;
+    std::ostream* query_log_ = nullptr;
+    std::chrono::steady_clock::time_point log_start_time_;
  
-    void AddRequest(int results_num);
+    void AddRequest(const std::string& raw_query, int results_num);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
     const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(result.size());
+    AddRequest(raw_query, result.size());
     return result;
 }
@@ -0,0 +1,149 @@
+#include "search_metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+size_t GetThreadIndex() {
+    static std::atomic<size_t> next_index{0};
+    thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+}  // namespace
+
+void WriteFileAtomically(const std::string& path, const std::function<void(std::ostream&)>& write) {
+    const std::string tmp_path = path + ".tmp"s;
+    {
+        std::ofstream out(tmp_path);
+        if (!out) {
+            throw std::runtime_error("Can't open file "s + tmp_path);
+        }
+        write(out);
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Can't rename "s + tmp_path + " to "s + path);
+    }
+}
+
+SearchMetrics::SearchMetrics(const SearchMetrics& other) {
+    SetEnabled(other.IsEnabled());
+}
+
+SearchMetrics& SearchMetrics::operator=(const SearchMetrics& other) {
+    if (this != &other) {
+        Reset();
+        SetEnabled(other.IsEnabled());
+    }
+    return *this;
+}
+
+void SearchMetrics::SetEnabled(bool enabled) {
+    if (enabled && !shards_) {
+        shard_count_ = std::max(1u, std::thread::hardware_concurrency());
+        shards_.reset(new Shard[shard_count_]);
+    }
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void SearchMetrics::Record(SearchStage stage, Clock::duration duration) const {
+    if (!shards_) {
+        return;
+    }
+    const size_t stage_index = static_cast<size_t>(stage);
+    const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    Shard& shard = shards_[GetThreadIndex() % shard_count_];
+    shard.latencies[stage_index].Record(nanoseconds);
+    shard.total_ns[stage_index].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void SearchMetrics::SetStageObserver(StageObserver* observer) {
+    observer_ = observer;
+}
+
+SearchMetrics::StageSnapshot SearchMetrics::GetSnapshot(SearchStage stage) const {
+    StageSnapshot snapshot;
+    const size_t stage_index = static_cast<size_t>(stage);
+    for (size_t i = 0; shards_ && i < shard_count_; ++i) {
+        shards_[i].latencies[stage_index].AddTo(snapshot.counts);
+        snapshot.total_ns += shards_[i].total_ns[stage_index].load(std::memory_order_relaxed);
+    }
+    snapshot.count = LatencyHistogram::ComputeTotal(snapshot.counts);
+    return snapshot;
+}
+
+void SearchMetrics::Reset() {
+    for (size_t i = 0; shards_ && i < shard_count_; ++i) {
+        for (size_t stage_index = 0; stage_index < SEARCH_STAGE_COUNT; ++stage_index) {
+            shards_[i].latencies[stage_index].Reset();
+            shards_[i].total_ns[stage_index].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void SearchMetrics::WritePrometheus(std::ostream& out) const {
+    const auto write_seconds = [&out](uint64_t nanoseconds) {
+        out << nanoseconds / 1'000'000'000 << '.';
+        const std::string fraction = std::to_string(nanoseconds % 1'000'000'000);
+        out << std::string(9 - fraction.size(), '0') << fraction;
+    };
+
+    out << "# HELP search_server_stage_duration_seconds Duration of search server stages.\n"s;
+    out << "# TYPE search_server_stage_duration_seconds histogram\n"s;
+    for (size_t stage_index = 0; stage_index < SEARCH_STAGE_COUNT; ++stage_index) {
+        const SearchStage stage = static_cast<SearchStage>(stage_index);
+        const StageSnapshot snapshot = GetSnapshot(stage);
+        const std::string labels = "{stage=\""s + GetStageName(stage) + "\""s;
+
+        // buckets are exported at powers of two only, which keeps
+        // the exposition short and the same for every scrape
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            cumulative += snapshot.counts[i];
+            const bool is_last_sub_bucket = i >= LatencyHistogram::SUB_BUCKET_COUNT
+                && i % LatencyHistogram::SUB_BUCKET_COUNT == LatencyHistogram::SUB_BUCKET_COUNT - 1;
+            if (is_last_sub_bucket && i + 1 < LatencyHistogram::BUCKET_COUNT) {
+                out << "search_server_stage_duration_seconds_bucket"s << labels << ",le=\""s;
+                write_seconds(LatencyHistogram::ToUpperBound(i) + 1);
+                out << "\"} "s << cumulative << '\n';
+            }
+        }
+        out << "search_server_stage_duration_seconds_bucket"s << labels << ",le=\"+Inf\"} "s << snapshot.count << '\n';
+        out << "search_server_stage_duration_seconds_sum"s << labels << "} "s;
+        write_seconds(snapshot.total_ns);
+        out << '\n';
+        out << "search_server_stage_duration_seconds_count"s << labels << "} "s << snapshot.count << '\n';
+    }
+}
+
+void SearchMetrics::ExportPrometheus(const std::string& path) const {
+    WriteFileAtomically(path, [this](std::ostream& out) {
+        WritePrometheus(out);
+    });
+}
+
+const char* SearchMetrics::GetStageName(SearchStage stage) {
+    switch (stage) {
+        case SearchStage::PARSE_QUERY:
+            return "parse_query";
+        case SearchStage::LOOKUP_TERMS:
+            return "lookup_terms";
+        case SearchStage::SCORE:
+            return "score";
+        case SearchStage::FILTER_MINUS_WORDS:
+            return "filter_minus_words";
+        case SearchStage::SELECT_TOP:
+            return "select_top";
+        case SearchStage::ADD_DOCUMENT:
+            return "add_document";
+        case SearchStage::REMOVE_DOCUMENT:
+            return "remove_document";
+    }
+    return "unknown";
+}
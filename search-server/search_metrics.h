@@ -0,0 +1,126 @@
+#pragma once
+#include "latency_histogram.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+
+enum class SearchStage {
+    PARSE_QUERY,
+    LOOKUP_TERMS,
+    SCORE,
+    FILTER_MINUS_WORDS,
+    SELECT_TOP,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+};
+
+const size_t SEARCH_STAGE_COUNT = 7;
+
+// Writes a file under a temporary name and renames it to path, so a
+// collector never reads a partially written file
+void WriteFileAtomically(const std::string& path, const std::function<void(std::ostream&)>& write);
+
+// Gets notified about stages executed while metrics are enabled, e.g.
+// to read hardware counters around them. Calls come from the thread
+// executing the stage
+class StageObserver {
+public:
+    virtual ~StageObserver() = default;
+    virtual void OnStageStart(SearchStage stage) = 0;
+    virtual void OnStageFinish(SearchStage stage) = 0;
+};
+
+// Latency histograms of the stages of SearchServer. Disabled metrics
+// cost one relaxed load per stage and no memory; enabled metrics are
+// recorded with nanosecond resolution into histograms sharded by thread.
+// A copy of metrics keeps only the enabled flag, not the measurements
+class SearchMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct StageSnapshot {
+        LatencyHistogram::Counts counts{};
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+    };
+
+    SearchMetrics() = default;
+    SearchMetrics(const SearchMetrics& other);
+    SearchMetrics& operator=(const SearchMetrics& other);
+
+    // Not synchronized with running queries: switch metrics on or off
+    // before the server gets shared between threads
+    void SetEnabled(bool enabled);
+
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void Record(SearchStage stage, Clock::duration duration) const;
+
+    // Not synchronized with running queries, nullptr removes the observer
+    void SetStageObserver(StageObserver* observer);
+
+    StageObserver* GetStageObserver() const {
+        return observer_;
+    }
+
+    StageSnapshot GetSnapshot(SearchStage stage) const;
+
+    void Reset();
+
+    // Prometheus text exposition format, one histogram per stage
+    void WritePrometheus(std::ostream& out) const;
+
+    // Writes the metrics to path with WriteFileAtomically
+    void ExportPrometheus(const std::string& path) const;
+
+    static const char* GetStageName(SearchStage stage);
+
+private:
+    struct alignas(64) Shard {
+        LatencyHistogram latencies[SEARCH_STAGE_COUNT];
+        std::atomic<uint64_t> total_ns[SEARCH_STAGE_COUNT] = {};
+    };
+
+    std::atomic<bool> enabled_ = false;
+    size_t shard_count_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+    StageObserver* observer_ = nullptr;
+};
+
+// Records the time from construction to destruction as a stage
+// of search. Doesn't read the clock when metrics are disabled
+class StageTimer {
+public:
+    StageTimer(const SearchMetrics& metrics, SearchStage stage)
+        : metrics_(metrics.IsEnabled() ? &metrics : nullptr)
+        , stage_(stage) {
+        if (metrics_) {
+            if (StageObserver* observer = metrics_->GetStageObserver()) {
+                observer->OnStageStart(stage_);
+            }
+            start_time_ = SearchMetrics::Clock::now();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        if (metrics_) {
+            metrics_->Record(stage_, SearchMetrics::Clock::now() - start_time_);
+            if (StageObserver* observer = metrics_->GetStageObserver()) {
+                observer->OnStageFinish(stage_);
+            }
+        }
+    }
+
+private:
+    const SearchMetrics* metrics_;
+    SearchStage stage_;
+    SearchMetrics::Clock::time_point start_time_;
+};
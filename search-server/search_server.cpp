@@ -1,47 +1,485 @@
 #include "search_server.h"
 
+#include <iomanip>
+#include <new>
+#include <unordered_set>
+
+SearchServer::~SearchServer() {
+    // Empty containers are built over the filled ones without destroying
+    // them: their nodes are only memory of index_memory_, which is freed
+    // chunk by chunk after them. Millions of nodes are not visited, and
+    // nothing of them has to be released but memory
+    new (&word_to_document_freqs_) decltype(word_to_document_freqs_)(&index_memory_);
+    new (&documents_) decltype(documents_)(&index_memory_);
+}
+
 void SearchServer::AddDocument(int document_id,
                  const std::string_view document,
                  DocumentStatus status, 
                  const std::vector<int>& ratings) {
+    StageTimer timer(metrics_, SearchStage::ADD_DOCUMENT);
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw std::invalid_argument("The document ID must not be less than zero and the document ID must not match the one already added"s);
     }
     std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
-    for (const std::string_view word : words) {
-        std::string str_word(word);
-        word_to_document_freqs_[str_word][document_id] += inv_word_count;
-        auto it = word_to_document_freqs_.find(str_word);
-        document_id_to_word_freqs_[document_id][it->first] += inv_word_count;
+
+    uint64_t fingerprint = 0;
+    if (duplicate_policy_ != DuplicatePolicy::IGNORE) {
+        const std::unordered_set<std::string_view> word_set(words.begin(), words.end());
+        const std::vector<std::string_view> unique_words(word_set.begin(), word_set.end());
+        fingerprint = ComputeFingerprint(unique_words);
+        if (duplicate_policy_ == DuplicatePolicy::REJECT
+            && !FindSameWordsDocuments(fingerprint, unique_words).empty()) {
+            throw std::invalid_argument("The document has the same set of words as an already added document"s);
+        }
+    }
+
+    impact_index_.reset();
+    std::map<std::string_view, TermCount> word_counts;
+    std::map<std::string_view, std::vector<uint32_t>> word_to_positions;
+    for (size_t position = 0; position < words.size(); ++position) {
+        ++word_counts[words[position]];
+        if (has_positional_index_) {
+            word_to_positions[words[position]].push_back(static_cast<uint32_t>(position));
+        }
+    }
+
+    DocumentData document_data{ComputeAverageRating(ratings),
+                               status,
+                               fingerprint,
+                               static_cast<int>(words.size())};
+    document_data.forward_offset = forward_entries_.size();
+    for (const auto [word, count] : word_counts) {
+        auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
+            it = word_to_document_freqs_.emplace(std::piecewise_construct, std::forward_as_tuple(word),
+                                                 std::forward_as_tuple(static_cast<TermId>(term_words_.size()),
+                                                                       &index_memory_)).first;
+            term_words_.push_back(it->first);
+        }
+        // documents are mostly added in the order of ids, and the hint
+        // saves the search from the root then
+        PostingList& postings = it->second.status_postings[static_cast<size_t>(status)];
+        postings.emplace_hint(postings.end(), document_id, count);
+        if (has_forward_index_) {
+            forward_entries_.push_back({it->second.id, count});
+        }
+        if (has_positional_index_) {
+            word_to_document_positions_[it->first][document_id] = EncodePositions(word_to_positions.at(word));
+        }
+    }
+    document_data.forward_size = static_cast<uint32_t>(forward_entries_.size() - document_data.forward_offset);
+    documents_.emplace_hint(documents_.end(), document_id, document_data);
+    document_ids_.Add(document_id);
+    status_to_document_ids_[static_cast<size_t>(status)].Add(document_id);
+    if (duplicate_policy_ != DuplicatePolicy::IGNORE) {
+        fingerprint_to_documents_[fingerprint].push_back(document_id);
+    }
+}
+
+CollectionStatistics SearchServer::GetQueryStatistics(const std::string_view raw_query) const {
+    const Query query = ParseQuery(raw_query);
+    CollectionStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    for (const std::string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && it->second.GetDocumentFreq() > 0) {
+            statistics.document_freqs.emplace(word, static_cast<int>(it->second.GetDocumentFreq()));
+        }
+    }
+    // the most frequent words of the collection aren't always the most
+    // frequent here, so the expansion limit isn't applied to the part
+    for (const std::string_view prefix : query.prefixes) {
+        auto& expansions = statistics.prefix_expansions[std::string(prefix)];
+        expansions.clear();
+        GetPrefixDictionary()->ForEachWithPrefix(prefix, [this, &statistics, &expansions](size_t, std::string_view word) {
+            const size_t document_freq = word_to_document_freqs_.find(word)->second.GetDocumentFreq();
+            if (document_freq > 0) {
+                expansions.emplace_back(word);
+                statistics.document_freqs.emplace(word, static_cast<int>(document_freq));
+            }
+            return true;
+        });
+    }
+    return statistics;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                     DocumentStatus status,
+                                                     const CollectionStatistics& statistics) const {
+    const Query query = ParseQuery(raw_query, true, &statistics);
+    auto matched_documents = FindAllDocuments(query, StatusPredicate{status});
+
+    StageTimer timer(metrics_, SearchStage::SELECT_TOP);
+    sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    if (policy != DuplicatePolicy::IGNORE && !has_forward_index_) {
+        throw std::invalid_argument("Duplicate tracking requires the forward index"s);
+    }
+    if (policy == DuplicatePolicy::IGNORE) {
+        fingerprint_to_documents_.clear();
+    } else if (duplicate_policy_ == DuplicatePolicy::IGNORE) {
+        for (auto& [document_id, document_data] : documents_) {
+            std::vector<std::string_view> unique_words;
+            for (const auto [word, freq] : GetWordFrequencies(document_id)) {
+                unique_words.push_back(word);
+            }
+            document_data.fingerprint = ComputeFingerprint(unique_words);
+            fingerprint_to_documents_[document_data.fingerprint].push_back(document_id);
+        }
+    }
+    duplicate_policy_ = policy;
+}
+
+void SearchServer::SetPositionalIndex(bool is_enabled) {
+    if (is_enabled && !has_positional_index_ && !documents_.empty()) {
+        throw std::invalid_argument("The positional index can be enabled only before documents are added"s);
+    }
+    has_positional_index_ = is_enabled;
+    if (!is_enabled) {
+        word_to_document_positions_.clear();
     }
-    documents_.emplace(document_id, 
-                       DocumentData{ComputeAverageRating(ratings), 
-                       status});
-    document_ids_.insert(document_id);
 }
 
+bool SearchServer::HasPositionalIndex() const {
+    return has_positional_index_;
+}
+
+void SearchServer::SetForwardIndex(bool is_enabled) {
+    if (is_enabled == has_forward_index_) {
+        return;
+    }
+    if (!is_enabled) {
+        if (duplicate_policy_ != DuplicatePolicy::IGNORE) {
+            throw std::invalid_argument("The forward index is required by duplicate tracking"s);
+        }
+        std::vector<ForwardEntry>().swap(forward_entries_);
+        removed_forward_entries_ = 0;
+        for (auto& [document_id, document_data] : documents_) {
+            document_data.forward_offset = 0;
+            document_data.forward_size = 0;
+        }
+        has_forward_index_ = false;
+        return;
+    }
+
+    // the dictionary is walked in alphabetical order, so the words of
+    // every document come sorted
+    for (const auto& [word, term] : word_to_document_freqs_) {
+        for (const PostingList& postings : term.status_postings) {
+            for (const auto [document_id, count] : postings) {
+                ++documents_.at(document_id).forward_size;
+            }
+        }
+    }
+    size_t offset = 0;
+    for (auto& [document_id, document_data] : documents_) {
+        document_data.forward_offset = offset;
+        offset += document_data.forward_size;
+        document_data.forward_size = 0;
+    }
+    forward_entries_.resize(offset);
+    for (const auto& [word, term] : word_to_document_freqs_) {
+        for (const PostingList& postings : term.status_postings) {
+            for (const auto [document_id, count] : postings) {
+                DocumentData& document_data = documents_.at(document_id);
+                forward_entries_[document_data.forward_offset + document_data.forward_size++] = {term.id, count};
+            }
+        }
+    }
+    has_forward_index_ = true;
+}
+
+bool SearchServer::HasForwardIndex() const {
+    return has_forward_index_;
+}
+
+void SearchServer::SetPrefixExpansionLimit(size_t limit) {
+    if (limit == 0) {
+        throw std::invalid_argument("Prefix expansion limit must be positive"s);
+    }
+    prefix_expansion_limit_ = limit;
+}
+
+size_t SearchServer::GetPrefixExpansionLimit() const {
+    return prefix_expansion_limit_;
+}
+
+void SearchServer::BuildImpactIndex() {
+    impact_index_.reset();
+    auto impact_index = std::make_unique<ImpactIndex>();
+    impact_index->term_postings.resize(term_words_.size());
+    if (documents_.empty()) {
+        impact_index_ = std::move(impact_index);
+        return;
+    }
+
+    // a hash of word counts saves a tree lookup in documents_ per
+    // posting; ids may be sparse, so they aren't indexes of an array
+    std::unordered_map<int, int> word_counts;
+    word_counts.reserve(documents_.size());
+    for (const auto& [document_id, document_data] : documents_) {
+        word_counts.emplace(document_id, document_data.word_count);
+    }
+    const double document_count = static_cast<double>(GetDocumentCount());
+    // same as ComputeWordInverseDocumentFreq of a query without statistics
+    const auto for_each_impact = [&](auto callback) {
+        for (const auto& [word, term] : word_to_document_freqs_) {
+            const size_t document_freq = term.GetDocumentFreq();
+            if (document_freq == 0) {
+                continue;
+            }
+            const double inverse_document_freq = log(document_count / document_freq);
+            for (size_t status = 0; status < term.status_postings.size(); ++status) {
+                for (const auto [document_id, term_count] : term.status_postings[status]) {
+                    callback(term.id, status, document_id,
+                             static_cast<double>(term_count) * inverse_document_freq / word_counts.at(document_id));
+                }
+            }
+        }
+    };
+
+    double max_impact = 0.0;
+    for_each_impact([&max_impact](TermId, size_t, int, double impact) {
+        max_impact = std::max(max_impact, impact);
+    });
+    if (max_impact > 0.0) {
+        impact_index->impact_step = max_impact / MAX_IMPACT_LEVEL;
+    }
+
+    // postings come by term and status in ascending order of id, the
+    // stable sort keeps it within a level
+    std::vector<std::pair<uint8_t, int>> levels;
+    std::optional<std::pair<TermId, size_t>> current_list;
+    const auto flush_list = [&] {
+        if (!current_list) {
+            return;
+        }
+        std::stable_sort(levels.begin(), levels.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first > rhs.first;
+        });
+        ImpactPostings& postings = impact_index->term_postings[current_list->first][current_list->second];
+        postings.document_ids.reserve(levels.size());
+        for (const auto& [level, document_id] : levels) {
+            if (!postings.segments.empty() && postings.segments.back().level == level) {
+                ++postings.segments.back().end;
+            } else {
+                postings.segments.push_back({static_cast<uint32_t>(postings.document_ids.size() + 1), level});
+            }
+            postings.document_ids.push_back(document_id);
+        }
+        postings.segments.shrink_to_fit();
+        levels.clear();
+    };
+    const double impact_step = impact_index->impact_step;
+    for_each_impact([&](TermId term_id, size_t status, int document_id, double impact) {
+        if (!current_list || *current_list != std::pair{term_id, status}) {
+            flush_list();
+            current_list = std::pair{term_id, status};
+        }
+        const int level = impact > 0.0
+            ? std::clamp(static_cast<int>(std::ceil(impact / impact_step)), 1, MAX_IMPACT_LEVEL)
+            : 0;
+        levels.push_back({static_cast<uint8_t>(level), document_id});
+    });
+    flush_list();
+    impact_index_ = std::move(impact_index);
+}
+
+bool SearchServer::HasImpactIndex() const {
+    return impact_index_ != nullptr;
+}
+
+DuplicatePolicy SearchServer::GetDuplicatePolicy() const {
+    return duplicate_policy_;
+}
+
+std::vector<int> SearchServer::GetDuplicateDocuments() const {
+    const auto same_words = [this](int lhs_id, int rhs_id) {
+        const auto& lhs = GetWordFrequencies(lhs_id);
+        const auto& rhs = GetWordFrequencies(rhs_id);
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                          [](const auto& lhs_item, const auto& rhs_item) {
+                              return lhs_item.first == rhs_item.first;
+                          });
+    };
+
+    std::vector<int> duplicates_id;
+    for (const auto& [fingerprint, documents] : fingerprint_to_documents_) {
+        if (documents.size() < 2) {
+            continue;
+        }
+        std::vector<int> ids(documents);
+        std::sort(ids.begin(), ids.end());
+        // documents of one bucket almost always share the same words,
+        // so comparing with the first document of every group is enough
+        std::vector<int> originals;
+        for (const int id : ids) {
+            const bool is_duplicate = std::any_of(originals.begin(), originals.end(),
+                                                  [&same_words, id](int original_id) {
+                                                      return same_words(original_id, id);
+                                                  });
+            if (is_duplicate) {
+                duplicates_id.push_back(id);
+            } else {
+                originals.push_back(id);
+            }
+        }
+    }
+    std::sort(duplicates_id.begin(), duplicates_id.end());
+    return duplicates_id;
+}
+
+
+SearchMetrics& SearchServer::GetMetrics() {
+    return metrics_;
+}
+
+const SearchMetrics& SearchServer::GetMetrics() const {
+    return metrics_;
+}
 
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
-std::set<int>::const_iterator SearchServer::begin() {
+const DocumentBitmap& SearchServer::GetDocumentIds() const {
+    return document_ids_;
+}
+
+const DocumentBitmap& SearchServer::GetDocumentIds(DocumentStatus status) const {
+    return status_to_document_ids_.at(static_cast<size_t>(status));
+}
+
+DocumentBitmap::Iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() {
+DocumentBitmap::Iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
-const std::map<std::string_view, double>& SearchServer
-    ::GetWordFrequencies(int document_id) const {
-    const auto it = document_id_to_word_freqs_.find(document_id);
-    if (it != document_id_to_word_freqs_.end()) {
-        return it->second;
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return {};
+    }
+    return {GetForwardBegin(it->second), GetForwardEnd(it->second), term_words_.data(), it->second.word_count};
+}
+
+IndexMemoryStats SearchServer::GetMemoryStats() const {
+    IndexMemoryStats stats;
+
+    // key of the dictionary node is the word, the posting list objects
+    // are counted with the postings. The nodes are in the arena
+    const size_t term_node_size = EstimateArenaTreeNodeSize(sizeof(std::pmr::string) + sizeof(TermData));
+    const size_t posting_node_size = EstimateArenaTreeNodeSize(sizeof(PostingList::value_type));
+    // the vector of words by id is counted as overhead of the dictionary
+    stats.term_dictionary.overhead_bytes += EstimateAllocationSize(term_words_.capacity() * sizeof(std::string_view));
+    for (const auto& [word, term] : word_to_document_freqs_) {
+        ++stats.term_dictionary.entries;
+        stats.term_dictionary.payload_bytes += word.size();
+        stats.term_dictionary.overhead_bytes += term_node_size - sizeof(term.status_postings) - word.size()
+            + EstimateArenaStringHeapSize(word);
+
+        const size_t document_freq = term.GetDocumentFreq();
+        stats.postings.entries += document_freq;
+        stats.postings.payload_bytes += document_freq * (sizeof(int) + sizeof(TermCount));
+        stats.postings.overhead_bytes += sizeof(term.status_postings)
+            + document_freq * (posting_node_size - sizeof(int) - sizeof(TermCount));
+
+        const size_t bucket = GetPostingLengthBucket(document_freq);
+        if (stats.posting_length_histogram.size() <= bucket) {
+            stats.posting_length_histogram.resize(bucket + 1);
+        }
+        ++stats.posting_length_histogram[bucket];
+    }
+
+    // ranges of removed documents are overhead until compaction
+    stats.forward_index.entries = forward_entries_.size() - removed_forward_entries_;
+    stats.forward_index.payload_bytes = stats.forward_index.entries * sizeof(ForwardEntry);
+    if (forward_entries_.capacity() > 0) {
+        stats.forward_index.overhead_bytes = EstimateAllocationSize(forward_entries_.capacity() * sizeof(ForwardEntry))
+            - stats.forward_index.payload_bytes;
+    }
+
+    const size_t positions_node_size = EstimateTreeNodeSize(sizeof(std::pair<const int, EncodedPositions>));
+    for (const auto& [word, document_positions] : word_to_document_positions_) {
+        stats.positions.overhead_bytes += EstimateTreeNodeSize(sizeof(word) + sizeof(document_positions));
+        for (const auto& [document_id, positions] : document_positions) {
+            ++stats.positions.entries;
+            stats.positions.payload_bytes += positions.size();
+            stats.positions.overhead_bytes += positions_node_size + EstimateAllocationSize(positions.capacity())
+                - positions.size();
+        }
+    }
+
+    {
+        std::lock_guard guard(prefix_dictionary_.mutex);
+        if (const auto& dictionary = prefix_dictionary_.dictionary) {
+            stats.prefix_dictionary.entries = dictionary->GetSize();
+            stats.prefix_dictionary.payload_bytes = dictionary->GetPayloadBytes();
+            // the object is allocated by make_shared together with two counters
+            stats.prefix_dictionary.overhead_bytes = dictionary->GetCapacityBytes() - dictionary->GetPayloadBytes()
+                + EstimateAllocationSize(sizeof(FrontCodedDictionary) + 2 * sizeof(long));
+        }
+    }
+
+    if (impact_index_) {
+        stats.impact_index.overhead_bytes = EstimateAllocationSize(sizeof(ImpactIndex))
+            + EstimateAllocationSize(impact_index_->term_postings.capacity() * sizeof(impact_index_->term_postings[0]));
+        for (const auto& status_postings : impact_index_->term_postings) {
+            for (const ImpactPostings& postings : status_postings) {
+                stats.impact_index.entries += postings.document_ids.size();
+                const size_t payload = postings.document_ids.size() * sizeof(int)
+                    + postings.segments.size() * sizeof(ImpactSegment);
+                stats.impact_index.payload_bytes += payload;
+                stats.impact_index.overhead_bytes += EstimateAllocationSize(postings.document_ids.capacity() * sizeof(int))
+                    + EstimateAllocationSize(postings.segments.capacity() * sizeof(ImpactSegment)) - payload;
+            }
+        }
+    }
+
+    const size_t data_node_size = EstimateArenaTreeNodeSize(sizeof(std::pair<const int, DocumentData>));
+    stats.documents.entries = documents_.size();
+    stats.documents.payload_bytes = documents_.size() * sizeof(std::pair<const int, DocumentData>);
+    stats.documents.overhead_bytes = documents_.size() * (data_node_size - sizeof(std::pair<const int, DocumentData>));
+    // bitmaps of ids, allocations of chunks are not counted separately
+    const auto add_bitmap = [&stats](const DocumentBitmap& bitmap) {
+        stats.documents.payload_bytes += bitmap.GetPayloadBytes();
+        stats.documents.overhead_bytes += bitmap.GetCapacityBytes() - bitmap.GetPayloadBytes();
+    };
+    add_bitmap(document_ids_);
+    for (const DocumentBitmap& bitmap : status_to_document_ids_) {
+        add_bitmap(bitmap);
+    }
+
+    const size_t stop_word_node_size = EstimateTreeNodeSize(sizeof(std::string));
+    for (const std::string& word : stop_words_) {
+        ++stats.stop_words.entries;
+        stats.stop_words.payload_bytes += word.size();
+        stats.stop_words.overhead_bytes += stop_word_node_size - word.size() + EstimateStringHeapSize(word);
     }
-    static std::map<std::string_view, double> tmp_res_;
-    return tmp_res_;
+
+    const size_t fingerprint_node_size = EstimateTreeNodeSize(sizeof(uint64_t) + sizeof(std::vector<int>));
+    for (const auto& [fingerprint, document_ids] : fingerprint_to_documents_) {
+        ++stats.duplicate_fingerprints.entries;
+        stats.duplicate_fingerprints.payload_bytes += sizeof(fingerprint) + document_ids.size() * sizeof(int);
+        stats.duplicate_fingerprints.overhead_bytes += fingerprint_node_size - sizeof(fingerprint)
+            + EstimateAllocationSize(document_ids.capacity() * sizeof(int)) - document_ids.size() * sizeof(int);
+    }
+
+    stats.index_arena.chunk_count = index_memory_.GetChunkCount();
+    stats.index_arena.reserved_bytes = index_memory_.GetReservedBytes();
+    stats.index_arena.used_bytes = index_memory_.GetUsedBytes();
+
+    return stats;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -49,128 +487,134 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id) {
-    if (documents_.count(document_id) == 0)
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end())
         return;
     
-    documents_.erase(document_id);
-        
-    const auto it = document_id_to_word_freqs_.find(document_id);
-    if (it == document_id_to_word_freqs_.end())
-        return;
-        
-    std::vector<std::string_view> tmp_words(it->second.size());
-
-    std::transform (policy,
-                    it->second.begin(), it->second.end(),
-                    tmp_words.begin(),
-                    [](const std::pair<std::string_view, double>& word_to_freq) { 
-                        return word_to_freq.first; 
-                    });
-
-    for_each (policy,
-              tmp_words.begin(), tmp_words.end(),
-              [this, &document_id](const std::string_view word) {
-                    word_to_document_freqs_.at(std::string(word)).erase(document_id);
-              });
-
-    document_id_to_word_freqs_.erase(document_id);
-    document_ids_.erase(document_id);
+    StageTimer timer(metrics_, SearchStage::REMOVE_DOCUMENT);
+    impact_index_.reset();
+    RemoveFingerprint(document_id);
+    RemoveFromIndex(policy, document_id, it->second);
+    status_to_document_ids_[static_cast<size_t>(it->second.status)].Remove(document_id);
+    documents_.erase(it);
+    document_ids_.Remove(document_id);
 }
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id) {
-    if (documents_.count(document_id) == 0)
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end())
         return;
     
-    documents_.erase(document_id);
-        
-    const auto it = document_id_to_word_freqs_.find(document_id);
-    if (it == document_id_to_word_freqs_.end())
-        return;
-        
-    std::vector<std::string_view> tmp_words(it->second.size());
+    StageTimer timer(metrics_, SearchStage::REMOVE_DOCUMENT);
+    impact_index_.reset();
+    RemoveFingerprint(document_id);
+    RemoveFromIndex(policy, document_id, it->second);
+    status_to_document_ids_[static_cast<size_t>(it->second.status)].Remove(document_id);
+    documents_.erase(it);
+    document_ids_.Remove(document_id);
+}
 
-    std::transform (policy,
-                    it->second.begin(), it->second.end(),
-                    tmp_words.begin(),
-                    [](const std::pair<std::string_view, double>& word_to_freq) { 
-                        return word_to_freq.first; 
-                    });
+template <typename ExecutionPolicy>
+void SearchServer::RemoveFromIndex(ExecutionPolicy policy, int document_id, const DocumentData& document_data) {
+    const size_t status_index = static_cast<size_t>(document_data.status);
+    // postings are extracted in parallel and their nodes are given back
+    // to the arena, which isn't synchronized, after the parallel part
+    std::vector<PostingList::node_type> erased_postings;
+    const auto erase_from_word = [this, document_id, status_index](const std::string_view word, TermData& term,
+                                                                    PostingList::node_type& erased_posting) {
+        erased_posting = term.status_postings[status_index].extract(document_id);
+        const auto positions_it = word_to_document_positions_.find(word);
+        if (positions_it != word_to_document_positions_.end()) {
+            positions_it->second.erase(document_id);
+        }
+    };
 
-    for_each (policy,
-              tmp_words.begin(), tmp_words.end(),
-              [this, &document_id](const std::string_view word) {
-                    word_to_document_freqs_.at(std::string(word)).erase(document_id);
-              });
+    if (!has_forward_index_) {
+        // every word is visited once, so the postings are erased in parallel
+        erased_postings.resize(term_words_.size());
+        std::for_each(policy,
+                      word_to_document_freqs_.begin(), word_to_document_freqs_.end(),
+                      [&erase_from_word, &erased_postings](auto& word_to_term) {
+                          TermData& term = word_to_term.second;
+                          erase_from_word(word_to_term.first, term, erased_postings[term.id]);
+                      });
+        return;
+    }
+
+    const ForwardEntry* const document_begin = GetForwardBegin(document_data);
+    erased_postings.resize(document_data.forward_size);
+    std::for_each(policy,
+                  document_begin, GetForwardEnd(document_data),
+                  [this, document_begin, &erase_from_word, &erased_postings](const ForwardEntry& entry) {
+                      const std::string_view word = term_words_[entry.term_id];
+                      erase_from_word(word, word_to_document_freqs_.find(word)->second,
+                                      erased_postings[&entry - document_begin]);
+                  });
 
-    document_id_to_word_freqs_.erase(document_id);
-    document_ids_.erase(document_id);
+    removed_forward_entries_ += document_data.forward_size;
+    if (removed_forward_entries_ * 2 > forward_entries_.size()) {
+        CompactForwardIndex(document_id);
+    }
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
     return SearchServer::MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query, int document_id) const {
-    Query query(ParseQuery(raw_query));
-    bool contains_minus = std::any_of(policy,
-                   query.minus_words.begin(), query.minus_words.end(),
-                   [this, &document_id](const std::string_view word) {
-                       return (word_to_document_freqs_.count(word) && 
-                               word_to_document_freqs_.at(std::string(word)).count(document_id));
-                   });
-
-    if (contains_minus) {
-        std::vector<std::string_view> empty;
-        return {empty, documents_.at(document_id).status};
-    }
-    
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto it = std::copy_if (policy, 
-                  query.plus_words.begin(), query.plus_words.end(),
-                  matched_words.begin(),
-                  [this, &document_id](const std::string_view word) {
-                      return (word_to_document_freqs_.count(word) &&
-                              word_to_document_freqs_.at(std::string(word)).count(document_id));
-                  });
-    
-    matched_words.resize(distance(matched_words.begin(), it));
-    return {matched_words, documents_.at(document_id).status};
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const {
+    const DocumentStatus status = documents_.at(document_id).status;
+    return {MatchWords(ParseQuery(raw_query), document_id), status};
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query, int document_id) const {
-    Query query(ParseQuery(raw_query, false));
-    bool contains_minus = std::any_of(policy,
-                   query.minus_words.begin(), query.minus_words.end(),
-                   [this, &document_id](const std::string_view word) {
-                       return (word_to_document_freqs_.count(word) && 
-                               word_to_document_freqs_.at(std::string(word)).count(document_id));
-                   });
+// a single document is matched faster by the merge than by splitting the work
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const {
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
 
-    if (contains_minus) {
-        std::vector<std::string_view> empty;
-        return {empty, documents_.at(document_id).status};
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    // checked before the parallel part, where an exception would terminate
+    for (const int document_id : document_ids) {
+        documents_.at(document_id);
     }
-    
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    auto it = std::copy_if (policy, 
-                  query.plus_words.begin(), query.plus_words.end(),
-                  matched_words.begin(),
-                  [this, &document_id](const std::string_view word) {
-                      return (word_to_document_freqs_.count(word) &&
-                              word_to_document_freqs_.at(std::string(word)).count(document_id));
-                  });
-    
-    matched_words.resize(distance(matched_words.begin(), it));
-    std::sort(matched_words.begin(), matched_words.end());
-    matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
-
-    return {matched_words, documents_.at(document_id).status};
+    const Query query = ParseQuery(raw_query);
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> results(document_ids.size());
+    std::transform(std::execution::par,
+                   document_ids.begin(), document_ids.end(),
+                   results.begin(),
+                   [this, &query](int document_id) {
+                       return std::tuple{MatchWords(query, document_id), documents_.at(document_id).status};
+                   });
+    return results;
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
+const ForwardEntry* SearchServer::GetForwardBegin(const DocumentData& document_data) const {
+    return forward_entries_.data() + document_data.forward_offset;
+}
+
+const ForwardEntry* SearchServer::GetForwardEnd(const DocumentData& document_data) const {
+    return forward_entries_.data() + document_data.forward_offset + document_data.forward_size;
+}
+
+void SearchServer::CompactForwardIndex(int removed_document_id) {
+    std::vector<ForwardEntry> entries;
+    entries.reserve(forward_entries_.size() - removed_forward_entries_);
+    for (auto& [document_id, document_data] : documents_) {
+        if (document_id == removed_document_id) {
+            continue;
+        }
+        const size_t offset = entries.size();
+        entries.insert(entries.end(), GetForwardBegin(document_data), GetForwardEnd(document_data));
+        document_data.forward_offset = offset;
+    }
+    forward_entries_.swap(entries);
+    removed_forward_entries_ = 0;
+}
+
 bool SearchServer::IsValidWord(const std::string_view word) {
     // A valid word must not contain special characters
     return std::none_of(word.begin(), word.end(), [](char c) {
@@ -198,6 +642,70 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+uint64_t SearchServer::ComputeFingerprint(const std::vector<std::string_view>& unique_words) {
+    uint64_t fingerprint = 0;
+    for (const std::string_view word : unique_words) {
+        // splitmix64 finalizer spreads bits of std::hash before summing
+        uint64_t hash = std::hash<std::string_view>{}(word);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        fingerprint += hash ^ (hash >> 31);
+    }
+    return fingerprint;
+}
+
+bool SearchServer::HasSameWords(int document_id, std::vector<std::string_view> unique_words) const {
+    const auto& word_freqs = GetWordFrequencies(document_id);
+    if (word_freqs.size() != unique_words.size()) {
+        return false;
+    }
+    std::sort(unique_words.begin(), unique_words.end());
+    return std::equal(word_freqs.begin(), word_freqs.end(), unique_words.begin(),
+                      [](const auto& word_freq, const std::string_view word) {
+                          return word_freq.first == word;
+                      });
+}
+
+std::vector<int> SearchServer::FindSameWordsDocuments(uint64_t fingerprint,
+                                                      const std::vector<std::string_view>& unique_words) const {
+    std::vector<int> result;
+    const auto it = fingerprint_to_documents_.find(fingerprint);
+    if (it == fingerprint_to_documents_.end()) {
+        return result;
+    }
+    for (const int document_id : it->second) {
+        if (HasSameWords(document_id, unique_words)) {
+            result.push_back(document_id);
+        }
+    }
+    return result;
+}
+
+void SearchServer::RemoveFingerprint(int document_id) {
+    if (duplicate_policy_ == DuplicatePolicy::IGNORE) {
+        return;
+    }
+    const auto it = fingerprint_to_documents_.find(documents_.at(document_id).fingerprint);
+    if (it == fingerprint_to_documents_.end()) {
+        return;
+    }
+    auto& documents = it->second;
+    documents.erase(std::find(documents.begin(), documents.end(), document_id));
+    if (documents.empty()) {
+        fingerprint_to_documents_.erase(it);
+    }
+}
+
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= PRECISION) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view word) const {
     bool is_minus = false;
     if (!word.empty() && word[0] == '-') {
@@ -211,16 +719,45 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view word) cons
     return {word, is_minus, IsStopWord(word)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool is_sec_exec) const {
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool is_sec_exec,
+                                             const CollectionStatistics* statistics) const {
+    StageTimer timer(metrics_, SearchStage::PARSE_QUERY);
     if (text.empty()) {
         throw std::invalid_argument("String of query is epmty"s);
     }
     
     Query query;
-    for (const std::string_view word : SplitIntoWords(text)) {
+    query.statistics = statistics;
+    const std::vector<std::string_view> words = SplitIntoWords(text);
+    for (size_t i = 0; i < words.size(); ++i) {
+        const std::string_view word = words[i];
+        if (has_positional_index_ && word[0] == '"') {
+            i = ParsePhrase(words, i, query) - 1;
+            continue;
+        }
+        if (has_positional_index_ && word.substr(0, 2) == "-\"") {
+            throw std::invalid_argument("Minus phrases are not supported"s);
+        }
         QueryWord query_word(ParseQueryWord(word));
         if (query_word.is_stop)
             continue;
+        if (query_word.data.back() == '*') {
+            const std::string_view prefix = query_word.data.substr(0, query_word.data.size() - 1);
+            if (prefix.empty()) {
+                throw std::invalid_argument("A prefix of query must not be empty"s);
+            }
+            query.prefixes.push_back(prefix);
+            auto& words = query_word.is_minus ? query.minus_words : query.plus_words;
+            if (statistics) {
+                const auto expansions_it = statistics->prefix_expansions.find(prefix);
+                if (expansions_it != statistics->prefix_expansions.end()) {
+                    words.insert(words.end(), expansions_it->second.begin(), expansions_it->second.end());
+                    continue;
+                }
+            }
+            ExpandPrefix(prefix, words);
+            continue;
+        }
         if (query_word.is_minus) {
             query.minus_words.push_back(query_word.data);
         } else {
@@ -238,6 +775,243 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool i
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(std::string(word)).size());
+size_t SearchServer::ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const {
+    Phrase phrase;
+    for (size_t i = first; i < words.size(); ++i) {
+        std::string_view word = words[i];
+        if (i == first) {
+            word.remove_prefix(1);
+        }
+        const size_t quote = word.find('"');
+        if (quote != std::string_view::npos) {
+            const std::string_view slop = word.substr(quote + 1);
+            word = word.substr(0, quote);
+            if (!slop.empty()) {
+                if (slop.size() < 2 || slop.size() > 10 || slop[0] != '~'
+                    || !std::all_of(slop.begin() + 1, slop.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                    throw std::invalid_argument("Proximity of a phrase must be written as \"words\"~N"s);
+                }
+                phrase.slop = std::stoi(std::string(slop.substr(1)));
+            }
+        }
+        if (!word.empty()) {
+            const QueryWord query_word = ParseQueryWord(word);
+            if (query_word.is_minus) {
+                throw std::invalid_argument("A phrase must not contain minus words"s);
+            }
+            if (!query_word.is_stop) {
+                phrase.words.push_back(query_word.data);
+                query.plus_words.push_back(query_word.data);
+            }
+        }
+        if (quote != std::string_view::npos) {
+            if (!phrase.words.empty()) {
+                query.phrases.push_back(std::move(phrase));
+            }
+            return i + 1;
+        }
+    }
+    throw std::invalid_argument("A phrase of query has no closing quote"s);
+}
+
+std::vector<std::string_view> SearchServer::MatchWords(const Query& query, int document_id) const {
+    std::vector<std::string_view> matched_words;
+    const auto data_it = documents_.find(document_id);
+    if (data_it == documents_.end()) {
+        return matched_words;
+    }
+
+    if (!has_forward_index_) {
+        const size_t status_index = static_cast<size_t>(data_it->second.status);
+        // returns the word of the index, the word of the query may be
+        // a view of the query text
+        const auto find_word = [this, document_id, status_index](const std::string_view word) -> const std::pmr::string* {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end() && it->second.status_postings[status_index].count(document_id) > 0) {
+                return &it->first;
+            }
+            return nullptr;
+        };
+        if (std::any_of(query.minus_words.begin(), query.minus_words.end(), find_word)
+            || !MatchesPhrases(query, document_id)) {
+            return matched_words;
+        }
+        for (const std::string_view word : query.plus_words) {
+            if (const std::pmr::string* index_word = find_word(word)) {
+                matched_words.push_back(*index_word);
+            }
+        }
+        return matched_words;
+    }
+
+    const ForwardEntry* const document_begin = GetForwardBegin(data_it->second);
+    const ForwardEntry* const document_end = GetForwardEnd(data_it->second);
+    const auto entry_less = [this](const ForwardEntry& entry, const std::string_view word) {
+        return term_words_[entry.term_id] < word;
+    };
+    // calls on_match(word of the document) for every query word in it
+    // and stops when on_match returns false
+    const auto merge = [this, document_begin, document_end, &entry_less](const std::vector<std::string_view>& words, auto on_match) {
+        // a short query is looked up in a long document instead of walking it
+        if (words.size() * 16 < static_cast<size_t>(document_end - document_begin)) {
+            for (const std::string_view word : words) {
+                const ForwardEntry* entry = std::lower_bound(document_begin, document_end, word, entry_less);
+                if (entry != document_end && term_words_[entry->term_id] == word && !on_match(term_words_[entry->term_id])) {
+                    return;
+                }
+            }
+            return;
+        }
+        auto word_it = words.begin();
+        const ForwardEntry* entry = document_begin;
+        while (word_it != words.end() && entry != document_end) {
+            const std::string_view document_word = term_words_[entry->term_id];
+            if (*word_it < document_word) {
+                ++word_it;
+            } else if (document_word < *word_it) {
+                ++entry;
+            } else {
+                if (!on_match(document_word)) {
+                    return;
+                }
+                ++word_it;
+                ++entry;
+            }
+        }
+    };
+
+    bool contains_minus = false;
+    merge(query.minus_words, [&contains_minus](std::string_view) {
+        contains_minus = true;
+        return false;
+    });
+    if (contains_minus || !MatchesPhrases(query, document_id)) {
+        return matched_words;
+    }
+    merge(query.plus_words, [&matched_words](std::string_view word) {
+        matched_words.push_back(word);
+        return true;
+    });
+    return matched_words;
+}
+
+bool SearchServer::MatchesPhrases(const Query& query, int document_id) const {
+    for (const Phrase& phrase : query.phrases) {
+        std::vector<std::vector<uint32_t>> positions;
+        for (const std::string_view word : phrase.words) {
+            const auto word_it = word_to_document_positions_.find(word);
+            if (word_it == word_to_document_positions_.end()) {
+                return false;
+            }
+            const auto it = word_it->second.find(document_id);
+            if (it == word_it->second.end()) {
+                return false;
+            }
+            positions.push_back(DecodePositions(it->second));
+        }
+        if (!ContainsPhrase(positions, phrase.slop)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const FrontCodedDictionary> SearchServer::GetPrefixDictionary() const {
+    std::lock_guard guard(prefix_dictionary_.mutex);
+    auto& dictionary = prefix_dictionary_.dictionary;
+    if (!dictionary || dictionary->GetSize() != word_to_document_freqs_.size()) {
+        std::vector<std::string_view> words;
+        words.reserve(word_to_document_freqs_.size());
+        for (const auto& [word, _] : word_to_document_freqs_) {
+            words.push_back(word);
+        }
+        dictionary = std::make_shared<const FrontCodedDictionary>(words);
+    }
+    return dictionary;
+}
+
+void SearchServer::ExpandPrefix(std::string_view prefix, std::vector<std::string_view>& words) const {
+    std::vector<std::pair<size_t, std::string_view>> expansions;
+    GetPrefixDictionary()->ForEachWithPrefix(prefix, [this, &expansions](size_t, std::string_view word) {
+        const auto it = word_to_document_freqs_.find(word);
+        const size_t document_freq = it->second.GetDocumentFreq();
+        if (document_freq > 0) {
+            expansions.push_back({document_freq, it->first});
+        }
+        return true;
+    });
+    SelectPrefixExpansions(expansions, prefix_expansion_limit_);
+    for (const auto& [_, word] : expansions) {
+        words.push_back(word);
+    }
+}
+
+void SearchServer::SelectPrefixExpansions(std::vector<std::pair<size_t, std::string_view>>& expansions, size_t limit) {
+    if (expansions.size() <= limit) {
+        return;
+    }
+    std::stable_sort(expansions.begin(), expansions.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first > rhs.first;
+    });
+    expansions.resize(limit);
+    std::sort(expansions.begin(), expansions.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second < rhs.second;
+    });
+}
+
+MatchStrategy SearchServer::ChooseMatchStrategy(size_t plus_postings, size_t plus_lists, size_t id_range) {
+    if (plus_lists < 2) {
+        return MatchStrategy::DOCUMENT_AT_A_TIME;
+    }
+    // a posting costs about a comparison per level of the heap, and
+    // a comparison about as much as clearing and walking 8 ids
+    const double heap_cost = static_cast<double>(plus_postings) * std::log2(static_cast<double>(plus_lists));
+    const double array_cost = static_cast<double>(id_range) / 8.0;
+    return array_cost < heap_cost ? MatchStrategy::TERM_AT_A_TIME : MatchStrategy::DOCUMENT_AT_A_TIME;
+}
+
+MinusWordStrategy SearchServer::ChooseMinusWordStrategy(size_t plus_postings, size_t minus_postings, size_t minus_lists) {
+    // a lookup walks a path of the tree with a cache miss on every level,
+    // about as much as scanning 16 postings
+    const double probe_cost = static_cast<double>(plus_postings) * static_cast<double>(minus_lists) * 16.0;
+    return probe_cost < static_cast<double>(minus_postings) ? MinusWordStrategy::PROBE : MinusWordStrategy::SCAN;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word, const Query& query) const {
+    if (query.statistics) {
+        const auto it = query.statistics->document_freqs.find(word);
+        if (it != query.statistics->document_freqs.end() && it->second > 0) {
+            return log(query.statistics->document_count * 1.0 / it->second);
+        }
+    }
+    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.find(word)->second.GetDocumentFreq());
+}
+
+void PrintQueryTrace(std::ostream& out, const QueryTrace& trace) {
+    out << "match: "s << (trace.match_strategy == MatchStrategy::TERM_AT_A_TIME ? "term at a time"s : "document at a time"s)
+        << ", minus words: "s << (trace.minus_word_strategy == MinusWordStrategy::PROBE ? "probe"s : "scan"s) << '\n';
+    out << std::left << std::setw(24) << "term"s << std::right << std::setw(12) << "documents"s
+        << std::setw(12) << "idf"s << "  flags"s << '\n';
+    for (const QueryTrace::Term& term : trace.terms) {
+        out << std::left << std::setw(24) << (term.is_minus ? "-"s : ""s) + term.word << std::right
+            << std::setw(12) << term.document_freq
+            << std::setw(12) << std::fixed << std::setprecision(4) << term.inverse_document_freq << std::defaultfloat;
+        if (term.is_deferred) {
+            out << "  deferred"s << (trace.deferred_terms_read ? ", read"s : ", skipped"s);
+        }
+        out << '\n';
+    }
+    out << "postings scanned: "s << trace.postings_scanned
+        << ", candidates: "s << trace.candidate_documents
+        << ", rejected by minus words: "s << trace.rejected_by_minus_words
+        << ", by predicate: "s << trace.rejected_by_predicate
+        << ", by phrases: "s << trace.rejected_by_phrases
+        << ", matched: "s << trace.matched_documents << '\n';
+    const auto microseconds = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration<double, std::micro>(time).count();
+    };
+    out << "time, us: parse "s << microseconds(trace.parse_time)
+        << ", lookup "s << microseconds(trace.lookup_time)
+        << ", score "s << microseconds(trace.score_time)
+        << ", select "s << microseconds(trace.select_time) << '\n';
 }
@@ -2,9 +2,17 @@
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "search_metrics.h"
+#include "memory_stats.h"
+#include "positional_index.h"
+#include "forward_index.h"
+#include "document_bitmap.h"
+#include "term_dictionary.h"
+#include "index_arena.h"
 #include <string>
 #include <vector>
 #include <set>
+#include <array>
 #include <map>
 #include <algorithm>
 #include <cmath>
@@ -13,11 +21,125 @@
 #include <execution>
 #include <string_view>
 #include <functional>
+#include <chrono>
+#include <tuple>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <queue>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
 
 using std::literals::string_literals::operator""s;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double PRECISION = 1e-6;
+const size_t DEFAULT_PREFIX_EXPANSION_LIMIT = 64;
+
+// How AddDocument treats a document whose set of words equals
+// the set of words of an already added document
+enum class DuplicatePolicy {
+    IGNORE,     // no duplicate tracking (default)
+    DETECT,     // document is added and reported by GetDuplicateDocuments
+    REJECT,     // AddDocument throws std::invalid_argument
+};
+
+// Position in the ranked results of a query, taken from the last
+// document of a page. Callers should treat it as opaque and only pass
+// it back to FindDocumentsAfter
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = -1;
+};
+
+// How the documents of the plus words are found, chosen by the query
+// planner from the lengths of the posting lists
+enum class MatchStrategy {
+    DOCUMENT_AT_A_TIME,     // merge of the lists in a heap
+    TERM_AT_A_TIME,         // lists summed one by one into an array over the range of ids
+};
+
+// How documents of the minus words are rejected
+enum class MinusWordStrategy {
+    SCAN,       // the lists are walked along with the candidates
+    PROBE,      // every candidate is looked up in the lists
+};
+
+// Execution trace of one query returned by ExplainTopDocuments
+struct QueryTrace {
+    struct Term {
+        std::string word;
+        bool is_minus = false;
+        size_t document_freq = 0;
+        double inverse_document_freq = 0.0;
+        // a plus word of zero IDF adds nothing to relevance, its postings
+        // are read only if the other words leave the top incomplete
+        bool is_deferred = false;
+    };
+
+    // plan of the query: plus words from the rarest, then minus words
+    // from the most frequent, the order in which they are probed
+    std::vector<Term> terms;
+    MatchStrategy match_strategy = MatchStrategy::DOCUMENT_AT_A_TIME;
+    MinusWordStrategy minus_word_strategy = MinusWordStrategy::SCAN;
+    bool deferred_terms_read = false;
+    // entries of posting lists read by the merge, plus and minus words,
+    // and lookups of the probes
+    size_t postings_scanned = 0;
+    // documents containing at least one plus word
+    size_t candidate_documents = 0;
+    size_t rejected_by_minus_words = 0;
+    size_t rejected_by_predicate = 0;
+    // documents without a phrase of the query
+    size_t rejected_by_phrases = 0;
+    size_t matched_documents = 0;
+    std::chrono::nanoseconds parse_time{0};
+    std::chrono::nanoseconds lookup_time{0};
+    std::chrono::nanoseconds score_time{0};
+    std::chrono::nanoseconds select_time{0};
+};
+
+// Plan and counters of the trace, one line per term
+void PrintQueryTrace(std::ostream& out, const QueryTrace& trace);
+
+// Document frequencies of the whole collection when the server keeps
+// a part of it, so that the parts rank documents like a single index
+struct CollectionStatistics {
+    int document_count = 0;
+    std::map<std::string, int, std::less<>> document_freqs;
+    // Words of the prefixes of the query, by the prefix without '*'.
+    // A part gives all its words with the prefix; the collection gives
+    // the words the prefix expands to instead of the local choice
+    std::map<std::string, std::vector<std::string>, std::less<>> prefix_expansions;
+};
+
+// Limit of the work of one query. Work is counted in postings read by
+// scoring, so a budget of postings gives the same result on every run;
+// a deadline depends on the speed of the machine
+struct SearchBudget {
+    size_t max_postings = std::numeric_limits<size_t>::max();
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    // the budget ran out, documents are the best of those found before
+    bool is_partial = false;
+    size_t postings_scanned = 0;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // empty when there are no documents after the page
+    std::optional<SearchCursor> next_cursor;
+};
 
 class SearchServer {
 public:
@@ -30,6 +152,13 @@ public:
     explicit SearchServer(const std::string_view stop_words_text)
         : SearchServer(SplitIntoWords(stop_words_text)) {}   
 
+    // The index refers to its own words by string_view, so a copy
+    // would point into the original
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+
+    ~SearchServer();
+
     void AddDocument(int document_id,
                      const std::string_view document,
                      DocumentStatus status, 
@@ -50,18 +179,12 @@ public:
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, 
                                            const std::string_view raw_query,
                                            DocumentStatus status) const {
-        return FindTopDocuments(policy, raw_query,
-            [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+        return FindTopDocuments(policy, raw_query, StatusPredicate{status});
     }
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query,
                                            DocumentStatus status) const {
-        return FindTopDocuments(std::execution::seq, raw_query,
-            [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+        return FindTopDocuments(std::execution::seq, raw_query, StatusPredicate{status});
     }
     
     template <typename ExecutionPolicy>
@@ -74,13 +197,194 @@ public:
         return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
     }
 
+    // Searches only the documents of an allow-list built by set
+    // operations, e.g. GetDocumentIds(DocumentStatus::ACTUAL) & acl
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy,
+                                           const std::string_view raw_query,
+                                           const DocumentBitmap& allowed_documents) const {
+        return FindTopDocuments(policy, raw_query,
+            [&allowed_documents](int document_id) {
+                return allowed_documents.Contains(document_id);
+            });
+    }
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentBitmap& allowed_documents) const {
+        return FindTopDocuments(std::execution::seq, raw_query, allowed_documents);
+    }
+
+    // Anytime search: posting lists are read from the highest IDF, the
+    // lists whose documents gain the most relevance, and the budget is
+    // checked while reading them. When it runs out the best documents
+    // of the postings read are returned as a partial result. Minus words
+    // and phrases are checked only for the documents of the top. Within
+    // the budget the result is that of FindTopDocuments up to rounding
+    // of relevance, which is summed in another order
+    template <typename DocumentPredicate>
+    SearchResult FindTopDocuments(const std::string_view raw_query,
+                                  DocumentPredicate document_predicate,
+                                  const SearchBudget& budget) const;
+
+    SearchResult FindTopDocuments(const std::string_view raw_query,
+                                  DocumentStatus status,
+                                  const SearchBudget& budget) const {
+        return FindTopDocuments(raw_query, StatusPredicate{status}, budget);
+    }
+
+    SearchResult FindTopDocuments(const std::string_view raw_query, const SearchBudget& budget) const {
+        return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, budget);
+    }
+
+    // Local document count and frequencies of the plus words of the
+    // query and of all the words with its prefixes; summed over the
+    // parts of a collection and with the expansions of the prefixes
+    // chosen by SelectPrefixExpansions they are passed to
+    // FindTopDocuments below
+    CollectionStatistics GetQueryStatistics(const std::string_view raw_query) const;
+
+    // Ranks with IDF of the whole collection instead of this server
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           DocumentStatus status,
+                                           const CollectionStatistics& statistics) const;
+
+    // Same results as the sequential FindTopDocuments together with
+    // a trace of the execution. Queries without trace don't pay for it
+    template <typename DocumentPredicate>
+    std::tuple<std::vector<Document>, QueryTrace> ExplainTopDocuments(const std::string_view raw_query,
+                                                                      DocumentPredicate document_predicate) const;
+
+    std::tuple<std::vector<Document>, QueryTrace> ExplainTopDocuments(const std::string_view raw_query,
+                                                                      DocumentStatus status) const {
+        return ExplainTopDocuments(raw_query, StatusPredicate{status});
+    }
+
+    std::tuple<std::vector<Document>, QueryTrace> ExplainTopDocuments(const std::string_view raw_query) const {
+        return ExplainTopDocuments(raw_query, DocumentStatus::ACTUAL);
+    }
+
+    // Search-after pagination: returns up to page_size documents ranked
+    // right after the cursor (from the top when there is no cursor).
+    // Only a heap of page_size documents is kept, so the cost doesn't
+    // depend on the depth of the page
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindDocumentsAfter(ExecutionPolicy policy,
+                                  const std::string_view raw_query,
+                                  DocumentPredicate document_predicate,
+                                  const std::optional<SearchCursor>& cursor,
+                                  size_t page_size) const;
+
+    template <typename DocumentPredicate>
+    SearchPage FindDocumentsAfter(const std::string_view raw_query,
+                                  DocumentPredicate document_predicate,
+                                  const std::optional<SearchCursor>& cursor,
+                                  size_t page_size) const {
+        return FindDocumentsAfter(std::execution::seq, raw_query, document_predicate, cursor, page_size);
+    }
+
+    SearchPage FindDocumentsAfter(const std::string_view raw_query,
+                                  DocumentStatus status,
+                                  const std::optional<SearchCursor>& cursor,
+                                  size_t page_size) const {
+        return FindDocumentsAfter(std::execution::seq, raw_query, StatusPredicate{status}, cursor, page_size);
+    }
+
+    SearchPage FindDocumentsAfter(const std::string_view raw_query,
+                                  const std::optional<SearchCursor>& cursor,
+                                  size_t page_size) const {
+        return FindDocumentsAfter(raw_query, DocumentStatus::ACTUAL, cursor, page_size);
+    }
+
+    // Calls visitor(document_id, relevance, rating) for every document
+    // matching the query, without collecting the matches. Documents are
+    // visited in ascending order of id; the visitor may return false to
+    // stop early. Returns false if the visitor stopped the search
+    template <typename DocumentPredicate, typename Visitor>
+    bool ForEachMatch(const std::string_view raw_query,
+                      DocumentPredicate document_predicate,
+                      Visitor visitor) const;
+
+    template <typename DocumentPredicate, typename Visitor>
+    bool ForEachMatch(std::execution::sequenced_policy policy,
+                      const std::string_view raw_query,
+                      DocumentPredicate document_predicate,
+                      Visitor visitor) const {
+        return ForEachMatch(raw_query, document_predicate, visitor);
+    }
+
+    // Ranges of ids are searched in parallel: the visitor is called
+    // concurrently and in no particular order
+    template <typename DocumentPredicate, typename Visitor>
+    bool ForEachMatch(std::execution::parallel_policy policy,
+                      const std::string_view raw_query,
+                      DocumentPredicate document_predicate,
+                      Visitor visitor) const;
+
+    // Per-stage latency histograms, disabled by default
+    SearchMetrics& GetMetrics();
+    const SearchMetrics& GetMetrics() const;
+
     int GetDocumentCount() const;
 
+    // Ids of all documents and of the documents with the status.
+    // Iterators are invalidated by AddDocument and RemoveDocument
+    const DocumentBitmap& GetDocumentIds() const;
+    const DocumentBitmap& GetDocumentIds(DocumentStatus status) const;
+
     //int GetDocumentId(int index) const;
-    std::set<int>::const_iterator begin();
-    std::set<int>::const_iterator end();
+    DocumentBitmap::Iterator begin() const;
+    DocumentBitmap::Iterator end() const;
+
+    // Empty for a missing document and without the forward index
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    // The forward index keeps the words of every document for
+    // GetWordFrequencies, duplicate tracking and fast MatchDocument and
+    // RemoveDocument. A replica that only answers queries can drop it:
+    // MatchDocument then looks words up in the postings and RemoveDocument
+    // scans the whole dictionary. Enabling it again rebuilds it from
+    // the postings
+    void SetForwardIndex(bool is_enabled);
+    bool HasForwardIndex() const;
+
+    // Keeps positions of words for phrase queries like "white cat" and
+    // proximity queries like "white cat"~2, that allow up to 2 other
+    // words between the words of the phrase. Positions are counted
+    // without stop words. Positions of added documents can't be
+    // restored, so the index can be enabled only on an empty server.
+    // Without the index quotes are ordinary characters of words
+    void SetPositionalIndex(bool is_enabled);
+    bool HasPositionalIndex() const;
+
+    // Query words like "cat*" are expanded to the words of the index
+    // starting with the prefix, and relevance is summed over all of
+    // them. Only limit words found in the most documents are taken
+    void SetPrefixExpansionLimit(size_t limit);
+    size_t GetPrefixExpansionLimit() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Impact-ordered copy of the postings for a static index: every
+    // posting gets its share of relevance, count * IDF / word count,
+    // quantized to 8 bits, and every list is sorted by it. While the
+    // copy exists, the sequential FindTopDocuments reads the postings of
+    // all query words from the highest impact down, stops once the
+    // unread postings can't change the top and scores the remaining
+    // candidates exactly, so the results stay the same. AddDocument and
+    // RemoveDocument drop the copy, since they change IDF
+    void BuildImpactIndex();
+    bool HasImpactIndex() const;
+
+    // Bytes and entries of every part of the index. Overhead of nodes
+    // and allocations is estimated, nothing is asked from the allocator
+    IndexMemoryStats GetMemoryStats() const;
+
+    // Enables incremental duplicate tracking. Fingerprints of already
+    // added documents are computed when tracking gets switched on
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+    DuplicatePolicy GetDuplicatePolicy() const;
+
+    // Ids of documents whose set of words equals the set of words
+    // of a document with a smaller id, in ascending order
+    std::vector<int> GetDuplicateDocuments() const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
@@ -93,25 +397,181 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query,
                                                         int document_id) const;
 
+    // Parses the query once and matches the documents in parallel,
+    // results go in the order of document_ids
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+        const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    // Keeps the limit words found in the most documents out of the
+    // (document frequency, word) pairs of a prefix sorted by word, ties
+    // go to the smaller word; the result is sorted by word
+    static void SelectPrefixExpansions(std::vector<std::pair<size_t, std::string_view>>& expansions, size_t limit);
+
+    // Ranking order of search results: by relevance, then by rating,
+    // ties are broken by id so that pages never overlap
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        uint64_t fingerprint = 0;
+        // count of words without stop words, TF of a word is its count
+        // in the posting list divided by it
+        int word_count = 0;
+        // range of the words of the document in forward_entries_
+        size_t forward_offset = 0;
+        uint32_t forward_size = 0;
     };
 
+    // Postings keep exact counts of words instead of TF: with an int key
+    // the value takes the same 8 bytes of a tree node as a 16-bit one.
+    // Relevance is summed as count * IDF and divided by the word count
+    // of the document once, which differs from the sum of TF * IDF only
+    // by rounding (a few ulps, far below PRECISION)
+    using TermCount = uint32_t;
+    using PostingList = std::pmr::map<int, TermCount>;
+
+    // ids are given to words in the order they first appear
+    using TermId = uint32_t;
+    // Postings are split by the status of documents, so queries for
+    // one status never read documents of the other statuses
+    struct TermData {
+        TermId id = 0;
+        // indexed by DocumentStatus
+        std::array<PostingList, 4> status_postings;
+
+        TermData(TermId id, std::pmr::memory_resource* memory)
+            : id(id)
+            , status_postings{{PostingList(memory), PostingList(memory), PostingList(memory), PostingList(memory)}} {}
+
+        size_t GetDocumentFreq() const {
+            size_t document_freq = 0;
+            for (const PostingList& postings : status_postings) {
+                document_freq += postings.size();
+            }
+            return document_freq;
+        }
+    };
+
+    // Predicate of the status-only overloads. It is recognized at compile
+    // time, and only the postings of the status are read instead of
+    // calling it for every document
+    struct StatusPredicate {
+        DocumentStatus status;
+
+        bool operator()(int, DocumentStatus document_status, int) const {
+            return document_status == status;
+        }
+    };
+
+    template <typename DocumentPredicate>
+    static constexpr bool IS_STATUS_PREDICATE = std::is_same_v<DocumentPredicate, StatusPredicate>;
+
+    // Calls visitor(postings) for the postings the predicate may accept
+    template <typename DocumentPredicate, typename Visitor>
+    static void ForEachStatusPostings(const TermData& term, const DocumentPredicate& document_predicate,
+                                      Visitor visitor);
+
     std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
-    std::map<int, std::map<std::string_view, double>> document_id_to_word_freqs_;
+    // Nodes of the dictionary, of the postings and of the documents are
+    // cut from chunks of the arena, the destructor frees the chunks
+    // without visiting the nodes. The arena isn't synchronized: the index
+    // is changed by one thread at a time, and parallel removal frees
+    // the postings after the parallel part
+    IndexArena index_memory_;
+    std::pmr::map<std::pmr::string, TermData, std::less<>> word_to_document_freqs_{&index_memory_};
+    // words of the dictionary by id
+    std::vector<std::string_view> term_words_;
+    std::pmr::map<int, DocumentData> documents_{&index_memory_};
+    DocumentBitmap document_ids_;
+    // indexed by DocumentStatus
+    std::array<DocumentBitmap, 4> status_to_document_ids_;
+    // words of all documents in one buffer, every document takes a range
+    // sorted by word. Ranges of removed documents stay until they make up
+    // half of the buffer, then the buffer is compacted
+    bool has_forward_index_ = true;
+    std::vector<ForwardEntry> forward_entries_;
+    size_t removed_forward_entries_ = 0;
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::IGNORE;
+    std::map<uint64_t, std::vector<int>> fingerprint_to_documents_;
+    // kept apart from the postings, so queries without phrases never
+    // read positions; keys point to the keys of word_to_document_freqs_
+    bool has_positional_index_ = false;
+    std::map<std::string_view, std::map<int, EncodedPositions>, std::less<>> word_to_document_positions_;
+
+    // Sorted dictionary for prefix queries, built by the first prefix
+    // query after new words were added. Words are never erased from
+    // word_to_document_freqs_, so a change of its size means new words
+    struct PrefixDictionary {
+        std::mutex mutex;
+        std::shared_ptr<const FrontCodedDictionary> dictionary;
+
+        PrefixDictionary() = default;
+        PrefixDictionary(const PrefixDictionary&) {
+        }
+        PrefixDictionary& operator=(const PrefixDictionary&) {
+            std::lock_guard guard(mutex);
+            dictionary.reset();
+            return *this;
+        }
+    };
+    mutable PrefixDictionary prefix_dictionary_;
+
+    // The impact of a posting of level q is in ((q - 1) * step, q * step],
+    // a posting of zero impact has level 0
+    static constexpr int MAX_IMPACT_LEVEL = 255;
+    // bounds of relevance are widened by it against rounding
+    static constexpr double IMPACT_BOUND_SLACK = 1e-9;
+
+    // Postings of a term in descending order of impact level, by id
+    // within a level; a segment is the run of postings of one level
+    struct ImpactSegment {
+        uint32_t end;
+        uint8_t level;
+    };
+    struct ImpactPostings {
+        std::vector<int> document_ids;
+        std::vector<ImpactSegment> segments;
+    };
+    struct ImpactIndex {
+        double impact_step = 1.0;
+        // indexed by term id, then by DocumentStatus
+        std::vector<std::array<ImpactPostings, 4>> term_postings;
+    };
+    std::unique_ptr<const ImpactIndex> impact_index_;
+    size_t prefix_expansion_limit_ = DEFAULT_PREFIX_EXPANSION_LIMIT;
+    SearchMetrics metrics_;
      
     bool IsStopWord(const std::string_view word) const;
 
+    const ForwardEntry* GetForwardBegin(const DocumentData& document_data) const;
+    const ForwardEntry* GetForwardEnd(const DocumentData& document_data) const;
+
+    // Copies the ranges of the documents but the removed one to a new
+    // buffer without gaps
+    void CompactForwardIndex(int removed_document_id);
+
+    // Erases the document from the postings and positions of its words
+    template <typename ExecutionPolicy>
+    void RemoveFromIndex(ExecutionPolicy policy, int document_id, const DocumentData& document_data);
+
     static bool IsValidWord(const std::string_view word);
     
     std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
+
+    // Order independent hash of a set of words, so it can be
+    // computed in one pass without sorting the words
+    static uint64_t ComputeFingerprint(const std::vector<std::string_view>& unique_words);
+
+    bool HasSameWords(int document_id, std::vector<std::string_view> unique_words) const;
+
+    std::vector<int> FindSameWordsDocuments(uint64_t fingerprint,
+                                            const std::vector<std::string_view>& unique_words) const;
+
+    void RemoveFingerprint(int document_id);
     
     struct QueryWord {
         std::string_view data;
@@ -121,14 +581,82 @@ private:
     
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    struct Phrase {
+        std::vector<std::string_view> words;
+        int slop = 0;
+    };
+
+    // words of phrases are plus words too, a phrase is required
+    // in every found document
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<Phrase> phrases;
+        // prefixes of the query without '*'
+        std::vector<std::string_view> prefixes;
+        // IDF of the collection if the server is a part of it
+        const CollectionStatistics* statistics = nullptr;
     };
     
-    Query ParseQuery(const std::string_view text, bool is_sec_exec = true) const;
+    // With statistics prefixes expand to the words they give
+    Query ParseQuery(const std::string_view text, bool is_sec_exec = true,
+                     const CollectionStatistics* statistics = nullptr) const;
+
+    // Parses the phrase starting at words[first], returns the index
+    // of the word after its closing quote
+    size_t ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const;
+
+    bool MatchesPhrases(const Query& query, int document_id) const;
+
+    // Merges the sorted unique words of the query with the sorted words
+    // of the document in the forward index, or looks them up in the
+    // postings without it; the words are views of the index, so they
+    // outlive the query
+    std::vector<std::string_view> MatchWords(const Query& query, int document_id) const;
+
+    std::shared_ptr<const FrontCodedDictionary> GetPrefixDictionary() const;
+
+    // Appends words of the index starting with prefix, as views
+    // of the keys of word_to_document_freqs_
+    void ExpandPrefix(std::string_view prefix, std::vector<std::string_view>& words) const;
+
+    double ComputeWordInverseDocumentFreq(const std::string_view word, const Query& query) const;
+
+    // the clock is read once in so many postings of a budgeted search
+    static constexpr size_t DEADLINE_CHECK_INTERVAL = 256;
+
+    template <typename Visitor>
+    static bool CallVisitor(Visitor& visitor, int document_id, double relevance, int rating);
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // A predicate may take only the id of a document instead of
+    // (id, status, rating), then it is checked before the data
+    // of the document is looked up
+    template <typename DocumentPredicate>
+    static constexpr bool IS_ID_PREDICATE = std::is_invocable_r_v<bool, DocumentPredicate&, int>;
+
+    template <typename DocumentPredicate>
+    bool MatchesPredicate(DocumentPredicate& document_predicate, int document_id) const;
+
+    // Calls visitor for the documents with ids in [first_id, last_id)
+    // matching the query, in ascending order of id. With top_count > 0
+    // only the documents that may get into the top top_count are sure
+    // to be visited: documents of plus words of zero IDF alone have zero
+    // relevance and are visited, last, only if fewer than top_count
+    // documents rank above them
+    template <typename DocumentPredicate, typename Visitor>
+    bool VisitMatches(const Query& query,
+                      DocumentPredicate& document_predicate,
+                      int64_t first_id, int64_t last_id,
+                      Visitor& visitor,
+                      size_t top_count,
+                      QueryTrace* trace = nullptr) const;
+
+    // Costs are counted in postings read. The heap merge pays a few
+    // comparisons per posting, the array pays for clearing and
+    // walking the whole range of ids
+    static MatchStrategy ChooseMatchStrategy(size_t plus_postings, size_t plus_lists, size_t id_range);
+    // Candidates are at most the plus postings
+    static MinusWordStrategy ChooseMinusWordStrategy(size_t plus_postings, size_t minus_postings, size_t minus_lists);
     
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(ExecutionPolicy policy,
@@ -140,6 +668,13 @@ private:
                                            DocumentPredicate document_predicate) const  {
         return FindAllDocuments(std::execution::seq, query, document_predicate);
     }
+
+    // Score-at-a-time search over impact_index_: segments of all plus
+    // words are read in descending order of level until no document
+    // outside the top can reach it. The top of FindAllDocuments
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByImpact(const Query& query,
+                                                   DocumentPredicate document_predicate) const;
 };
 
 template <typename StringContainer>
@@ -155,15 +690,15 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy,
                                             const std::string_view raw_query, 
                                             DocumentPredicate document_predicate) const {
     Query query = ParseQuery(raw_query);
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        if (impact_index_ && !query.statistics) {
+            return FindTopDocumentsByImpact(query, document_predicate);
+        }
+    }
     auto matched_documents = FindAllDocuments(policy, query, document_predicate);
 
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < PRECISION) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
+    StageTimer timer(metrics_, SearchStage::SELECT_TOP);
+    sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
@@ -171,42 +706,848 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy,
     return matched_documents;
 }
 
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(const std::string_view raw_query,
+                                            DocumentPredicate document_predicate,
+                                            const SearchBudget& budget) const {
+    const Query query = ParseQuery(raw_query);
+    SearchResult result;
+
+    struct ScoredPostings {
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+    std::vector<ScoredPostings> plus_postings;
+    std::vector<const PostingList*> minus_postings;
+    {
+        StageTimer timer(metrics_, SearchStage::LOOKUP_TERMS);
+        for (const std::string_view word : query.plus_words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            if (word_it == word_to_document_freqs_.end() || word_it->second.GetDocumentFreq() == 0) {
+                continue;
+            }
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word, query);
+            ForEachStatusPostings(word_it->second, document_predicate, [&](const PostingList& postings) {
+                if (!postings.empty()) {
+                    plus_postings.push_back({&postings, inverse_document_freq});
+                }
+            });
+        }
+        std::stable_sort(plus_postings.begin(), plus_postings.end(),
+                         [](const ScoredPostings& lhs, const ScoredPostings& rhs) {
+                             return lhs.inverse_document_freq > rhs.inverse_document_freq;
+                         });
+        for (const std::string_view word : query.minus_words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            if (word_it != word_to_document_freqs_.end()) {
+                ForEachStatusPostings(word_it->second, document_predicate, [&](const PostingList& postings) {
+                    if (!postings.empty()) {
+                        minus_postings.push_back(&postings);
+                    }
+                });
+            }
+        }
+    }
+
+    std::optional<StageTimer> timer(std::in_place, metrics_, SearchStage::SCORE);
+    const auto is_out_of_budget = [&budget, &result] {
+        if (result.postings_scanned >= budget.max_postings) {
+            return true;
+        }
+        return budget.deadline && result.postings_scanned % DEADLINE_CHECK_INTERVAL == 0
+            && std::chrono::steady_clock::now() >= *budget.deadline;
+    };
+    std::unordered_map<int, double> document_to_relevance;
+    for (const ScoredPostings& scored_postings : plus_postings) {
+        for (const auto [document_id, term_count] : *scored_postings.postings) {
+            if (is_out_of_budget()) {
+                result.is_partial = true;
+                break;
+            }
+            ++result.postings_scanned;
+            if (MatchesPredicate(document_predicate, document_id)) {
+                document_to_relevance[document_id] += static_cast<double>(term_count) * scored_postings.inverse_document_freq;
+            }
+        }
+        if (result.is_partial) {
+            break;
+        }
+    }
+
+    timer.emplace(metrics_, SearchStage::SELECT_TOP);
+    std::vector<Document> candidates;
+    candidates.reserve(document_to_relevance.size());
+    for (const auto [document_id, relevance] : document_to_relevance) {
+        const auto& document_data = documents_.at(document_id);
+        candidates.push_back({document_id, relevance / document_data.word_count, document_data.rating});
+    }
+    sort(candidates.begin(), candidates.end(), IsRankedBefore);
+    for (const Document& document : candidates) {
+        if (result.documents.size() == MAX_RESULT_DOCUMENT_COUNT) {
+            break;
+        }
+        const bool contains_minus = std::any_of(minus_postings.begin(), minus_postings.end(),
+                                                [&document](const PostingList* postings) {
+                                                    return postings->count(document.id) > 0;
+                                                });
+        if (contains_minus || (!query.phrases.empty() && !MatchesPhrases(query, document.id))) {
+            continue;
+        }
+        result.documents.push_back(document);
+    }
+    return result;
+}
+
+template <typename DocumentPredicate>
+std::tuple<std::vector<Document>, QueryTrace> SearchServer::ExplainTopDocuments(
+        const std::string_view raw_query,
+        DocumentPredicate document_predicate) const {
+    using Clock = std::chrono::steady_clock;
+    QueryTrace trace;
+
+    auto start_time = Clock::now();
+    const Query query = ParseQuery(raw_query);
+    trace.parse_time = Clock::now() - start_time;
+
+    const auto add_terms = [this, &query, &trace](const std::vector<std::string_view>& words, bool is_minus) {
+        const size_t first_term = trace.terms.size();
+        for (const std::string_view word : words) {
+            QueryTrace::Term term{std::string(word), is_minus};
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end() && it->second.GetDocumentFreq() > 0) {
+                term.document_freq = it->second.GetDocumentFreq();
+                term.inverse_document_freq = ComputeWordInverseDocumentFreq(word, query);
+                term.is_deferred = !is_minus && term.inverse_document_freq == 0.0;
+            }
+            trace.terms.push_back(std::move(term));
+        }
+        std::stable_sort(trace.terms.begin() + first_term, trace.terms.end(),
+                         [is_minus](const QueryTrace::Term& lhs, const QueryTrace::Term& rhs) {
+                             return is_minus ? lhs.document_freq > rhs.document_freq
+                                             : lhs.document_freq < rhs.document_freq;
+                         });
+    };
+    add_terms(query.plus_words, false);
+    add_terms(query.minus_words, true);
+
+    std::vector<Document> matched_documents;
+    const auto collect = [&matched_documents](int document_id, double relevance, int rating) {
+        matched_documents.push_back({document_id, relevance, rating});
+    };
+    VisitMatches(query, document_predicate, 0, std::numeric_limits<int64_t>::max(), collect,
+                 MAX_RESULT_DOCUMENT_COUNT, &trace);
+
+    start_time = Clock::now();
+    sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    trace.select_time = Clock::now() - start_time;
+
+    return {matched_documents, trace};
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindDocumentsAfter(ExecutionPolicy,
+                                            const std::string_view raw_query,
+                                            DocumentPredicate document_predicate,
+                                            const std::optional<SearchCursor>& cursor,
+                                            size_t page_size) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    Query query = ParseQuery(raw_query);
+    std::optional<Document> last;
+    if (cursor) {
+        last = Document(cursor->document_id, cursor->relevance, cursor->rating);
+    }
+
+    // the top of the heap is the worst document of the page
+    std::priority_queue<Document, std::vector<Document>, decltype(&IsRankedBefore)> page(IsRankedBefore);
+    bool has_more = false;
+    std::mutex page_mutex;
+    const auto add_to_page = [&](int document_id, double relevance, int rating) {
+        const Document document(document_id, relevance, rating);
+        if (last && !IsRankedBefore(*last, document)) {
+            return;
+        }
+        std::unique_lock<std::mutex> guard(page_mutex, std::defer_lock);
+        if constexpr (!std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+            guard.lock();
+        }
+        if (page.size() < page_size) {
+            page.push(document);
+        } else {
+            has_more = true;
+            if (IsRankedBefore(document, page.top())) {
+                page.pop();
+                page.push(document);
+            }
+        }
+    };
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        VisitMatches(query, document_predicate, 0, std::numeric_limits<int64_t>::max(), add_to_page, 0);
+    } else {
+        ForEachMatch(std::execution::par, raw_query, document_predicate, add_to_page);
+    }
+
+    SearchPage result;
+    result.documents.resize(page.size());
+    for (auto it = result.documents.rbegin(); it != result.documents.rend(); ++it) {
+        *it = page.top();
+        page.pop();
+    }
+    if (has_more) {
+        const Document& back = result.documents.back();
+        result.next_cursor = SearchCursor{back.relevance, back.rating, back.id};
+    }
+    return result;
+}
+
+template <typename DocumentPredicate, typename Visitor>
+bool SearchServer::ForEachMatch(const std::string_view raw_query,
+                                DocumentPredicate document_predicate,
+                                Visitor visitor) const {
+    const Query query = ParseQuery(raw_query);
+    return VisitMatches(query, document_predicate, 0, std::numeric_limits<int64_t>::max(), visitor, 0);
+}
+
+template <typename DocumentPredicate, typename Visitor>
+bool SearchServer::ForEachMatch(std::execution::parallel_policy policy,
+                                const std::string_view raw_query,
+                                DocumentPredicate document_predicate,
+                                Visitor visitor) const {
+    const Query query = ParseQuery(raw_query);
+    if (document_ids_.IsEmpty()) {
+        return true;
+    }
+
+    // ids of the documents are split into equal ranges, several per thread
+    const int64_t first_id = document_ids_.GetMin();
+    const int64_t end_id = document_ids_.GetMax() + int64_t(1);
+    const int64_t range_count = std::min<int64_t>(end_id - first_id,
+                                                  4 * std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::pair<int64_t, int64_t>> ranges;
+    for (int64_t i = 0; i < range_count; ++i) {
+        ranges.push_back({first_id + (end_id - first_id) * i / range_count,
+                          first_id + (end_id - first_id) * (i + 1) / range_count});
+    }
+
+    std::atomic<bool> is_stopped = false;
+    const auto guarded_visitor = [&visitor, &is_stopped](int document_id, double relevance, int rating) {
+        if (is_stopped.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (!CallVisitor(visitor, document_id, relevance, rating)) {
+            is_stopped.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    };
+    std::for_each(policy,
+                  ranges.begin(), ranges.end(),
+                  [this, &query, &document_predicate, &guarded_visitor](const std::pair<int64_t, int64_t>& range) {
+                      auto range_visitor = guarded_visitor;
+                      VisitMatches(query, document_predicate, range.first, range.second, range_visitor, 0);
+                  });
+    return !is_stopped.load();
+}
+
+template <typename Visitor>
+bool SearchServer::CallVisitor(Visitor& visitor, int document_id, double relevance, int rating) {
+    if constexpr (std::is_void_v<std::invoke_result_t<Visitor&, int, double, int>>) {
+        visitor(document_id, relevance, rating);
+        return true;
+    } else {
+        return visitor(document_id, relevance, rating);
+    }
+}
+
+template <typename DocumentPredicate, typename Visitor>
+void SearchServer::ForEachStatusPostings(const TermData& term, const DocumentPredicate& document_predicate,
+                                         Visitor visitor) {
+    if constexpr (IS_STATUS_PREDICATE<DocumentPredicate>) {
+        visitor(term.status_postings.at(static_cast<size_t>(document_predicate.status)));
+    } else {
+        for (const PostingList& postings : term.status_postings) {
+            visitor(postings);
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::MatchesPredicate(DocumentPredicate& document_predicate, int document_id) const {
+    if constexpr (IS_STATUS_PREDICATE<DocumentPredicate>) {
+        return true;
+    } else if constexpr (IS_ID_PREDICATE<DocumentPredicate>) {
+        return document_predicate(document_id);
+    } else {
+        const auto& document_data = documents_.at(document_id);
+        return document_predicate(document_id, document_data.status, document_data.rating);
+    }
+}
+
+template <typename DocumentPredicate, typename Visitor>
+bool SearchServer::VisitMatches(const Query& query,
+                                DocumentPredicate& document_predicate,
+                                int64_t first_id, int64_t last_id,
+                                Visitor& visitor,
+                                size_t top_count,
+                                QueryTrace* trace) const {
+    using PostingIterator = PostingList::const_iterator;
+    struct PostingCursor {
+        const PostingList* postings;
+        PostingIterator it;
+        PostingIterator end;
+        double inverse_document_freq;
+    };
+
+    // a document is in one partition of a word, so the cursors of
+    // the partitions are merged like cursors of different words.
+    // Without deferred_cursors no word is deferred
+    const auto open_cursors = [this, &query, &document_predicate, first_id, last_id](
+            const std::vector<std::string_view>& words,
+            std::vector<PostingCursor>& cursors, std::vector<PostingCursor>* deferred_cursors) {
+        for (const std::string_view word : words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            if (word_it == word_to_document_freqs_.end() || word_it->second.GetDocumentFreq() == 0) {
+                continue;
+            }
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_it->first, query);
+            auto& word_cursors = deferred_cursors && inverse_document_freq == 0.0 ? *deferred_cursors : cursors;
+            ForEachStatusPostings(word_it->second, document_predicate, [&](const PostingList& postings) {
+                if (postings.empty()) {
+                    return;
+                }
+                word_cursors.push_back({&postings,
+                                        postings.lower_bound(static_cast<int>(first_id)),
+                                        last_id > std::numeric_limits<int>::max()
+                                            ? postings.end()
+                                            : postings.lower_bound(static_cast<int>(last_id)),
+                                        inverse_document_freq});
+            });
+        }
+    };
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point trace_time;
+    if (trace) {
+        trace_time = Clock::now();
+    }
+
+    std::vector<PostingCursor> plus_cursors;
+    std::vector<PostingCursor> deferred_cursors;
+    std::vector<PostingCursor> minus_cursors;
+    {
+        StageTimer timer(metrics_, SearchStage::LOOKUP_TERMS);
+        open_cursors(query.plus_words, plus_cursors, top_count > 0 ? &deferred_cursors : nullptr);
+        open_cursors(query.minus_words, minus_cursors, nullptr);
+    }
+    if (trace) {
+        const auto now = Clock::now();
+        trace->lookup_time += now - trace_time;
+        trace_time = now;
+    }
+
+    // ids the cursors may reach; lengths of the lists are known only
+    // for the whole range, a part of it gets its share of the postings
+    int64_t range_first = first_id;
+    int64_t range_end = last_id;
+    double range_share = 1.0;
+    if (!document_ids_.IsEmpty()) {
+        const int64_t min_id = document_ids_.GetMin();
+        const int64_t end_id = document_ids_.GetMax() + int64_t(1);
+        range_first = std::max(first_id, min_id);
+        range_end = std::max(range_first, std::min(last_id, end_id));
+        range_share = static_cast<double>(range_end - range_first) / static_cast<double>(end_id - min_id);
+    }
+    const auto count_postings = [range_share](const std::vector<PostingCursor>& cursors) {
+        size_t postings = 0;
+        for (const PostingCursor& cursor : cursors) {
+            postings += cursor.postings->size();
+        }
+        return static_cast<size_t>(static_cast<double>(postings) * range_share);
+    };
+    const size_t plus_postings = count_postings(plus_cursors);
+    const MatchStrategy match_strategy = ChooseMatchStrategy(plus_postings, plus_cursors.size(),
+                                                             static_cast<size_t>(range_end - range_first));
+    const MinusWordStrategy minus_word_strategy = ChooseMinusWordStrategy(plus_postings, count_postings(minus_cursors),
+                                                                          minus_cursors.size());
+    if (minus_word_strategy == MinusWordStrategy::PROBE) {
+        // the most frequent word rejects a document with the fewest probes
+        std::stable_sort(minus_cursors.begin(), minus_cursors.end(), [](const PostingCursor& lhs, const PostingCursor& rhs) {
+            return lhs.postings->size() > rhs.postings->size();
+        });
+    }
+    // scanning cursors are rewound for the documents of deferred words
+    const std::vector<PostingCursor> minus_starts = deferred_cursors.empty() ? std::vector<PostingCursor>{} : minus_cursors;
+
+    // the counters are cheap enough to be kept for every query
+    size_t postings_scanned = 0;
+    size_t candidate_documents = 0;
+    size_t rejected_by_minus_words = 0;
+    size_t rejected_by_predicate = 0;
+    size_t rejected_by_phrases = 0;
+    size_t matched_documents = 0;
+    // documents which a document of deferred words alone can't outrank
+    size_t documents_above_deferred = 0;
+    bool is_finished = true;
+
+    // minus words are checked while merging, so their time is a part of SCORE
+    StageTimer timer(metrics_, SearchStage::SCORE);
+
+    const auto contains_minus_word = [&minus_cursors, minus_word_strategy, &postings_scanned](int document_id) {
+        if (minus_word_strategy == MinusWordStrategy::PROBE) {
+            for (const PostingCursor& cursor : minus_cursors) {
+                ++postings_scanned;
+                if (cursor.postings->count(document_id) > 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        bool contains_minus = false;
+        for (PostingCursor& cursor : minus_cursors) {
+            while (cursor.it != cursor.end && cursor.it->first < document_id) {
+                ++cursor.it;
+                ++postings_scanned;
+            }
+            contains_minus = contains_minus || (cursor.it != cursor.end && cursor.it->first == document_id);
+        }
+        return contains_minus;
+    };
+
+    // returns false when the visitor stops the search
+    const auto visit_candidate = [&](int document_id, double relevance) {
+        ++candidate_documents;
+
+        if constexpr (IS_ID_PREDICATE<DocumentPredicate>) {
+            if (!document_predicate(document_id)) {
+                ++rejected_by_predicate;
+                return true;
+            }
+        }
+
+        if (contains_minus_word(document_id)) {
+            ++rejected_by_minus_words;
+            return true;
+        }
+
+        const auto& document_data = documents_.at(document_id);
+        if constexpr (!IS_ID_PREDICATE<DocumentPredicate> && !IS_STATUS_PREDICATE<DocumentPredicate>) {
+            if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                ++rejected_by_predicate;
+                return true;
+            }
+        }
+        if (!query.phrases.empty() && !MatchesPhrases(query, document_id)) {
+            ++rejected_by_phrases;
+            return true;
+        }
+        relevance /= document_data.word_count;
+        ++matched_documents;
+        if (relevance >= PRECISION) {
+            ++documents_above_deferred;
+        }
+        if (!CallVisitor(visitor, document_id, relevance, document_data.rating)) {
+            is_finished = false;
+            return false;
+        }
+        return true;
+    };
+
+    // Both strategies call on_document(document_id, relevance) in
+    // ascending order of id and stop when it returns false. Relevance
+    // is summed in the order of the plus words either way, so it is
+    // the same to the last bit
+    const auto merge = [&postings_scanned](std::vector<PostingCursor>& cursors, auto on_document) {
+        // min-heap of (document id, index of cursor)
+        using HeapItem = std::pair<int, size_t>;
+        std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            if (cursors[i].it != cursors[i].end) {
+                heap.push({cursors[i].it->first, i});
+            }
+        }
+        while (!heap.empty()) {
+            const int document_id = heap.top().first;
+            double relevance = 0.0;
+            while (!heap.empty() && heap.top().first == document_id) {
+                const size_t index = heap.top().second;
+                PostingCursor& cursor = cursors[index];
+                heap.pop();
+                ++postings_scanned;
+                relevance += static_cast<double>(cursor.it->second) * cursor.inverse_document_freq;
+                if (++cursor.it != cursor.end) {
+                    heap.push({cursor.it->first, index});
+                }
+            }
+            if (!on_document(document_id, relevance)) {
+                return;
+            }
+        }
+    };
+    const auto accumulate = [&postings_scanned, range_first, range_end](std::vector<PostingCursor>& cursors, auto on_document) {
+        const size_t range_size = static_cast<size_t>(range_end - range_first);
+        std::vector<double> relevances(range_size);
+        std::vector<uint64_t> is_candidate((range_size + 63) / 64);
+        for (PostingCursor& cursor : cursors) {
+            for (; cursor.it != cursor.end; ++cursor.it) {
+                const size_t index = static_cast<size_t>(cursor.it->first - range_first);
+                relevances[index] += static_cast<double>(cursor.it->second) * cursor.inverse_document_freq;
+                is_candidate[index / 64] |= uint64_t(1) << (index % 64);
+                ++postings_scanned;
+            }
+        }
+        for (size_t word = 0; word < is_candidate.size(); ++word) {
+            for (uint64_t bits = is_candidate[word]; bits != 0; bits &= bits - 1) {
+                const size_t index = word * 64 + __builtin_ctzll(bits);
+                if (!on_document(static_cast<int>(range_first + index), relevances[index])) {
+                    return;
+                }
+            }
+        }
+    };
+
+    // ids of the candidates, kept to skip them among the documents
+    // of deferred words
+    std::vector<int> scored_documents;
+    const auto on_scored_document = [&](int document_id, double relevance) {
+        if (!deferred_cursors.empty()) {
+            scored_documents.push_back(document_id);
+        }
+        return visit_candidate(document_id, relevance);
+    };
+    if (match_strategy == MatchStrategy::TERM_AT_A_TIME) {
+        accumulate(plus_cursors, on_scored_document);
+    } else {
+        merge(plus_cursors, on_scored_document);
+    }
+
+    const bool reads_deferred = is_finished && !deferred_cursors.empty() && documents_above_deferred < top_count;
+    if (reads_deferred) {
+        minus_cursors = minus_starts;
+        auto scored_it = scored_documents.begin();
+        merge(deferred_cursors, [&](int document_id, double relevance) {
+            scored_it = std::lower_bound(scored_it, scored_documents.end(), document_id);
+            if (scored_it != scored_documents.end() && *scored_it == document_id) {
+                return true;
+            }
+            return visit_candidate(document_id, relevance);
+        });
+    }
+
+    if (trace) {
+        trace->match_strategy = match_strategy;
+        trace->minus_word_strategy = minus_word_strategy;
+        trace->deferred_terms_read = trace->deferred_terms_read || reads_deferred;
+        trace->postings_scanned += postings_scanned;
+        trace->candidate_documents += candidate_documents;
+        trace->rejected_by_minus_words += rejected_by_minus_words;
+        trace->rejected_by_predicate += rejected_by_predicate;
+        trace->rejected_by_phrases += rejected_by_phrases;
+        trace->matched_documents += matched_documents;
+        trace->score_time += Clock::now() - trace_time;
+    }
+    return is_finished;
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy,
                                                      const Query& query,
                                                      DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(50);
-    for_each(policy, 
-            query.plus_words.begin(), query.plus_words.end(),
-            [this, &document_predicate, &document_to_relevance](const std::string_view word) {
-                if (word_to_document_freqs_.count(word)) {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-                       const auto& document_data = documents_.at(document_id);
-                       if (document_predicate(document_id, document_data.status, document_data.rating)) { 
-                           document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                       }
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        std::vector<Document> matched_documents;
+        const auto collect = [&matched_documents](int document_id, double relevance, int rating) {
+            matched_documents.push_back({document_id, relevance, rating});
+        };
+        VisitMatches(query, document_predicate, 0, std::numeric_limits<int64_t>::max(), collect,
+                     MAX_RESULT_DOCUMENT_COUNT);
+        return matched_documents;
+    }
+
+    // plus words of zero IDF add nothing to relevance: they are left
+    // out, and the search is repeated with them only if the other words
+    // find fewer documents than the top holds
+    std::vector<std::string_view> scored_words;
+    for (const std::string_view word : query.plus_words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end() || word_it->second.GetDocumentFreq() == 0
+            || ComputeWordInverseDocumentFreq(word, query) > 0.0) {
+            scored_words.push_back(word);
+        }
+    }
+    const auto find_documents = [this, &policy, &query, &document_predicate](const std::vector<std::string_view>& plus_words) {
+        ConcurrentMap<int, double> document_to_relevance(50);
+        std::optional<StageTimer> timer(std::in_place, metrics_, SearchStage::SCORE);
+        for_each(policy, 
+                plus_words.begin(), plus_words.end(),
+                [this, &query, &document_predicate, &document_to_relevance](const std::string_view word) {
+                    const auto word_it = word_to_document_freqs_.find(word);
+                    if (word_it != word_to_document_freqs_.end()) {
+                        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word, query);
+                        ForEachStatusPostings(word_it->second, document_predicate, [&](const PostingList& postings) {
+                            for (const auto [document_id, term_count] : postings) {
+                                if (MatchesPredicate(document_predicate, document_id)) {
+                                    document_to_relevance[document_id].ref_to_value += static_cast<double>(term_count) * inverse_document_freq;
+                                }
+                            }
+                        });
                     }
-                }
-            });
-    
-    for_each(policy,
-            query.minus_words.begin(), query.minus_words.end(),
-            [this, &document_to_relevance, &policy](const std::string_view word) {
-                if (word_to_document_freqs_.count(word)) {
-                    for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-                        document_to_relevance.erase(document_id);
+                });
+        
+        timer.emplace(metrics_, SearchStage::FILTER_MINUS_WORDS);
+        for_each(policy,
+                query.minus_words.begin(), query.minus_words.end(),
+                [this, &document_predicate, &document_to_relevance](const std::string_view word) {
+                    const auto word_it = word_to_document_freqs_.find(word);
+                    if (word_it != word_to_document_freqs_.end()) {
+                        ForEachStatusPostings(word_it->second, document_predicate, [&](const PostingList& postings) {
+                            for (const auto [document_id, _] : postings) {
+                                document_to_relevance.erase(document_id);
+                            }
+                        });
                     }
-                }
+                });
+
+        std::vector<Document> matched_documents;
+        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
+            if (!query.phrases.empty() && !MatchesPhrases(query, document_id)) {
+                continue;
+            }
+            const auto& document_data = documents_.at(document_id);
+            matched_documents.push_back({
+                document_id,
+                relevance / document_data.word_count,
+                document_data.rating
             });
+        }
+        return matched_documents;
+    };
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back({
-            document_id,
-            relevance,
-            documents_.at(document_id).rating
-        });
+    std::vector<Document> matched_documents = find_documents(scored_words);
+    if (scored_words.size() < query.plus_words.size()) {
+        const auto above_deferred = std::count_if(matched_documents.begin(), matched_documents.end(),
+                                                  [](const Document& document) {
+                                                      return document.relevance >= PRECISION;
+                                                  });
+        if (above_deferred < MAX_RESULT_DOCUMENT_COUNT) {
+            matched_documents = find_documents(query.plus_words);
+        }
     }
     return matched_documents;
 }
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const Query& query,
+                                                             DocumentPredicate document_predicate) const {
+    struct ScoredTerm {
+        const TermData* term;
+        double inverse_document_freq;
+    };
+    std::vector<ScoredTerm> plus_terms;
+    std::vector<const ImpactPostings*> plus_lists;
+    std::vector<const PostingList*> minus_postings;
+    {
+        StageTimer timer(metrics_, SearchStage::LOOKUP_TERMS);
+        for (const std::string_view word : query.plus_words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            if (word_it == word_to_document_freqs_.end() || word_it->second.GetDocumentFreq() == 0) {
+                continue;
+            }
+            const TermData& term = word_it->second;
+            plus_terms.push_back({&term, ComputeWordInverseDocumentFreq(word, query)});
+            const auto& status_lists = impact_index_->term_postings[term.id];
+            for (size_t status = 0; status < status_lists.size(); ++status) {
+                if constexpr (IS_STATUS_PREDICATE<DocumentPredicate>) {
+                    if (status != static_cast<size_t>(document_predicate.status)) {
+                        continue;
+                    }
+                }
+                if (!status_lists[status].document_ids.empty()) {
+                    plus_lists.push_back(&status_lists[status]);
+                }
+            }
+        }
+        for (const std::string_view word : query.minus_words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            if (word_it != word_to_document_freqs_.end()) {
+                ForEachStatusPostings(word_it->second, document_predicate, [&](const PostingList& postings) {
+                    if (!postings.empty()) {
+                        minus_postings.push_back(&postings);
+                    }
+                });
+            }
+        }
+    }
+
+    std::optional<StageTimer> timer(std::in_place, metrics_, SearchStage::SCORE);
+    // segments of all lists in descending order of level
+    struct SegmentRef {
+        uint8_t level;
+        uint32_t list;
+        uint32_t segment;
+    };
+    std::vector<SegmentRef> schedule;
+    // sum of the levels of the first unread segments of the lists, any
+    // document gains at most remaining_levels * impact_step more
+    uint64_t remaining_levels = 0;
+    for (uint32_t list = 0; list < plus_lists.size(); ++list) {
+        const auto& segments = plus_lists[list]->segments;
+        for (uint32_t segment = 0; segment < segments.size(); ++segment) {
+            schedule.push_back({segments[segment].level, list, segment});
+        }
+        remaining_levels += segments.front().level;
+    }
+    std::stable_sort(schedule.begin(), schedule.end(), [](const SegmentRef& lhs, const SegmentRef& rhs) {
+        return lhs.level > rhs.level;
+    });
+
+    // sums of the upper and lower bounds of the impacts read, in levels
+    struct Accumulator {
+        int document_id;
+        uint32_t level_sum = 0;
+        uint32_t lower_level_sum = 0;
+    };
+    std::vector<Accumulator> accumulators;
+    // Ids of the documents seen so far, open addressing with linear
+    // probing. A slot holds the index of the accumulator or REJECTED, so
+    // the memory grows with the documents read, not with the index
+    const int EMPTY_SLOT = -1;
+    const int32_t REJECTED = -1;
+    struct Slot {
+        int document_id = -1;
+        int32_t accumulator = -1;
+    };
+    std::vector<Slot> slots(64);
+    size_t used_slots = 0;
+    const auto get_slot_index = [EMPTY_SLOT](const std::vector<Slot>& table, int document_id) {
+        const size_t mask = table.size() - 1;
+        size_t index = (static_cast<uint32_t>(document_id) * 0x9E3779B1u) & mask;
+        while (table[index].document_id != EMPTY_SLOT && table[index].document_id != document_id) {
+            index = (index + 1) & mask;
+        }
+        return index;
+    };
+    const double impact_step = impact_index_->impact_step;
+    const size_t top_count = MAX_RESULT_DOCUMENT_COUNT;
+
+    const auto is_accepted = [&](int document_id) {
+        if (!MatchesPredicate(document_predicate, document_id)) {
+            return false;
+        }
+        for (const PostingList* postings : minus_postings) {
+            if (postings->count(document_id) > 0) {
+                return false;
+            }
+        }
+        return query.phrases.empty() || MatchesPhrases(query, document_id);
+    };
+
+    // lower bound of the relevance of the last document of the top; it
+    // only grows, so a stale value is still a bound
+    double top_threshold = -std::numeric_limits<double>::infinity();
+    std::vector<double> lower_bounds;
+    size_t postings_since_threshold = 0;
+    const auto update_threshold = [&] {
+        postings_since_threshold = 0;
+        if (accumulators.size() < top_count) {
+            return;
+        }
+        lower_bounds.clear();
+        for (const Accumulator& accumulator : accumulators) {
+            lower_bounds.push_back(accumulator.lower_level_sum * impact_step);
+        }
+        std::nth_element(lower_bounds.begin(), lower_bounds.begin() + (top_count - 1), lower_bounds.end(),
+                         std::greater<>());
+        top_threshold = lower_bounds[top_count - 1];
+    };
+    // a document below the threshold by PRECISION is ranked after all
+    // of the top whatever its rating is
+    const auto is_top_stable = [&] {
+        return remaining_levels * impact_step + IMPACT_BOUND_SLACK < top_threshold - PRECISION;
+    };
+
+    size_t position = 0;
+    while (position < schedule.size()) {
+        // the threshold is recomputed once in as many postings as there
+        // are candidates, which keeps it linear in the postings read
+        if (!is_top_stable() && postings_since_threshold >= accumulators.size()) {
+            update_threshold();
+        }
+        if (is_top_stable()) {
+            break;
+        }
+        const uint8_t level = schedule[position].level;
+        for (; position < schedule.size() && schedule[position].level == level; ++position) {
+            const SegmentRef& ref = schedule[position];
+            const ImpactPostings& list = *plus_lists[ref.list];
+            const uint32_t begin = ref.segment == 0 ? 0 : list.segments[ref.segment - 1].end;
+            const uint32_t end = list.segments[ref.segment].end;
+            for (uint32_t i = begin; i < end; ++i) {
+                const int document_id = list.document_ids[i];
+                size_t slot_index = get_slot_index(slots, document_id);
+                if (slots[slot_index].document_id == EMPTY_SLOT) {
+                    // the table is kept at most half full
+                    if (2 * (used_slots + 1) > slots.size()) {
+                        std::vector<Slot> grown_slots(2 * slots.size());
+                        for (const Slot& slot : slots) {
+                            if (slot.document_id != EMPTY_SLOT) {
+                                grown_slots[get_slot_index(grown_slots, slot.document_id)] = slot;
+                            }
+                        }
+                        slots.swap(grown_slots);
+                        slot_index = get_slot_index(slots, document_id);
+                    }
+                    ++used_slots;
+                    slots[slot_index].document_id = document_id;
+                    if (is_accepted(document_id)) {
+                        slots[slot_index].accumulator = static_cast<int32_t>(accumulators.size());
+                        accumulators.push_back({document_id});
+                    }
+                }
+                if (slots[slot_index].accumulator != REJECTED) {
+                    Accumulator& accumulator = accumulators[slots[slot_index].accumulator];
+                    accumulator.level_sum += level;
+                    accumulator.lower_level_sum += level > 0 ? level - 1 : 0;
+                }
+            }
+            postings_since_threshold += end - begin;
+            remaining_levels -= level;
+            if (ref.segment + 1 < list.segments.size()) {
+                remaining_levels += list.segments[ref.segment + 1].level;
+            }
+        }
+    }
+
+    // candidates are the documents whose upper bound reaches the top;
+    // their relevance is summed as in FindAllDocuments, in the order
+    // of the plus words, so it is the same to the last bit
+    timer.emplace(metrics_, SearchStage::SELECT_TOP);
+    update_threshold();
+    std::sort(accumulators.begin(), accumulators.end(), [](const Accumulator& lhs, const Accumulator& rhs) {
+        return lhs.document_id < rhs.document_id;
+    });
+    std::vector<Document> top_documents;
+    for (const Accumulator& accumulator : accumulators) {
+        const int document_id = accumulator.document_id;
+        const double upper_bound = (accumulator.level_sum + remaining_levels) * impact_step + IMPACT_BOUND_SLACK;
+        if (upper_bound < top_threshold - PRECISION) {
+            continue;
+        }
+        const auto& document_data = documents_.at(document_id);
+        double relevance = 0.0;
+        for (const ScoredTerm& scored_term : plus_terms) {
+            const PostingList& postings = scored_term.term->status_postings[static_cast<size_t>(document_data.status)];
+            const auto posting_it = postings.find(document_id);
+            if (posting_it != postings.end()) {
+                relevance += static_cast<double>(posting_it->second) * scored_term.inverse_document_freq;
+            }
+        }
+        top_documents.push_back({document_id, relevance / document_data.word_count, document_data.rating});
+    }
+    sort(top_documents.begin(), top_documents.end(), IsRankedBefore);
+    if (top_documents.size() > top_count) {
+        top_documents.resize(top_count);
+    }
+    return top_documents;
+}
@@ -0,0 +1,250 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../query_client.h"
+#include "../latency_histogram.h"
+
+using std::literals::string_literals::operator""s;
+
+/*
+ * Client of search_daemon.
+ *
+ * Build from the search-server directory:
+ *
+ *  g++ -std=c++17 -O2 -DNDEBUG server/search_client.cpp $(ls *.cpp | grep -v main.cpp) \
+ *      -ltbb -lpthread -o search_client
+ *
+ * Usage: search_client (--socket PATH | --port N) COMMAND
+ *  search QUERY [STATUS]
+ *  match ID QUERY
+ *  add ID STATUS TEXT [RATING...]
+ *  remove ID
+ *  fill COUNT             adds documents 0..COUNT-1 of 20 random words
+ *                         out of 1000, pipelined
+ *  bench [--connections N] [--pipeline N] [--duration SECONDS] QUERY...
+ *                         searches the queries in turn from N connections
+ *                         (4) with N requests in flight on each (16), then
+ *                         prints throughput and latency percentiles
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+DocumentStatus ParseStatus(const std::string& text) {
+    if (text == "ACTUAL"s) {
+        return DocumentStatus::ACTUAL;
+    } else if (text == "IRRELEVANT"s) {
+        return DocumentStatus::IRRELEVANT;
+    } else if (text == "BANNED"s) {
+        return DocumentStatus::BANNED;
+    } else if (text == "REMOVED"s) {
+        return DocumentStatus::REMOVED;
+    }
+    throw std::invalid_argument("Unknown status "s + text);
+}
+
+const char* GetStatusName(DocumentStatus status) {
+    switch (status) {
+    case DocumentStatus::ACTUAL:
+        return "ACTUAL";
+    case DocumentStatus::IRRELEVANT:
+        return "IRRELEVANT";
+    case DocumentStatus::BANNED:
+        return "BANNED";
+    case DocumentStatus::REMOVED:
+        return "REMOVED";
+    }
+    return "";
+}
+
+struct Endpoint {
+    std::string unix_socket_path;
+    uint16_t tcp_port = 0;
+
+    std::unique_ptr<QueryClient> Connect() const {
+        if (!unix_socket_path.empty()) {
+            return std::make_unique<QueryClient>(unix_socket_path);
+        }
+        return std::make_unique<QueryClient>(tcp_port);
+    }
+};
+
+void Fill(QueryClient& client, int count) {
+    const int window = 1000;
+    uint64_t state = 42;
+    int received = 0;
+    for (int id = 0; id < count; ++id) {
+        QueryRequest request;
+        request.type = QueryRequestType::ADD_DOCUMENT;
+        request.document_id = id;
+        for (int i = 0; i < 20; ++i) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            request.text += "w"s + std::to_string((state >> 33) % 1000) + " "s;
+        }
+        request.ratings = {id % 10};
+        client.Send(std::move(request));
+        if (id + 1 - received >= window || id + 1 == count) {
+            client.Flush();
+            for (; received <= id; ++received) {
+                const QueryResponse response = client.Receive();
+                if (response.is_error) {
+                    std::cerr << "Error: "s << response.error << std::endl;
+                }
+            }
+        }
+    }
+}
+
+void Bench(const Endpoint& endpoint, int argc, char* argv[], int first) {
+    int connections = 4;
+    int pipeline = 16;
+    double duration_s = 5.0;
+    std::vector<std::string> queries;
+    for (int i = first; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--"s, 0) == 0 && i + 1 < argc) {
+            const std::string value = argv[++i];
+            if (arg == "--connections"s) {
+                connections = std::max(1, std::stoi(value));
+            } else if (arg == "--pipeline"s) {
+                pipeline = std::max(1, std::stoi(value));
+            } else if (arg == "--duration"s) {
+                duration_s = std::stod(value);
+            } else {
+                throw std::invalid_argument("Unknown option "s + arg);
+            }
+        } else {
+            queries.push_back(arg);
+        }
+    }
+    if (queries.empty()) {
+        throw std::invalid_argument("bench requires queries"s);
+    }
+
+    LatencyHistogram latency;
+    std::atomic<uint64_t> errors = 0;
+    std::atomic<uint64_t> completed = 0;
+    const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(duration_s));
+    const auto start_time = Clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < connections; ++t) {
+        threads.emplace_back([&, t] {
+            const auto client = endpoint.Connect();
+            std::unordered_map<uint64_t, Clock::time_point> send_times;
+            size_t next_query = t;
+            const auto send = [&] {
+                QueryRequest request;
+                request.text = queries[next_query++ % queries.size()];
+                send_times[client->Send(std::move(request))] = Clock::now();
+            };
+            for (int i = 0; i < pipeline; ++i) {
+                send();
+            }
+            client->Flush();
+            while (!send_times.empty()) {
+                const QueryResponse response = client->Receive();
+                const auto it = send_times.find(response.id);
+                latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - it->second).count());
+                send_times.erase(it);
+                completed.fetch_add(1, std::memory_order_relaxed);
+                if (response.is_error) {
+                    errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (Clock::now() < deadline) {
+                    send();
+                    client->Flush();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start_time).count();
+
+    LatencyHistogram::Counts counts{};
+    latency.AddTo(counts);
+    std::cout << std::fixed << std::setprecision(1)
+              << "requests: "s << completed.load() << ", errors: "s << errors.load()
+              << ", qps: "s << completed.load() / seconds << '\n'
+              << "latency us: p50 "s << LatencyHistogram::ComputePercentile(counts, 50) / 1e3
+              << ", p99 "s << LatencyHistogram::ComputePercentile(counts, 99) / 1e3
+              << ", p999 "s << LatencyHistogram::ComputePercentile(counts, 99.9) / 1e3 << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Endpoint endpoint;
+        int i = 1;
+        for (; i + 1 < argc && std::string(argv[i]).rfind("--"s, 0) == 0; i += 2) {
+            const std::string arg = argv[i];
+            if (arg == "--socket"s) {
+                endpoint.unix_socket_path = argv[i + 1];
+            } else if (arg == "--port"s) {
+                endpoint.tcp_port = static_cast<uint16_t>(std::stoi(argv[i + 1]));
+            } else {
+                throw std::invalid_argument("Unknown option "s + arg);
+            }
+        }
+        if (i >= argc) {
+            throw std::invalid_argument("No command, see the comment at the top of search_client.cpp"s);
+        }
+        const std::string command = argv[i++];
+        const auto require = [argc, i](int count) {
+            if (argc - i < count) {
+                throw std::invalid_argument("Not enough arguments"s);
+            }
+        };
+
+        if (command == "bench"s) {
+            Bench(endpoint, argc, argv, i);
+            return 0;
+        }
+        const auto client = endpoint.Connect();
+        if (command == "search"s) {
+            require(1);
+            const DocumentStatus status = argc - i > 1 ? ParseStatus(argv[i + 1]) : DocumentStatus::ACTUAL;
+            for (const Document& document : client->FindTopDocuments(argv[i], status)) {
+                std::cout << "{ document_id = "s << document.id << ", relevance = "s << document.relevance
+                          << ", rating = "s << document.rating << " }"s << std::endl;
+            }
+        } else if (command == "match"s) {
+            require(2);
+            const auto [words, status] = client->MatchDocument(argv[i + 1], std::stoi(argv[i]));
+            std::cout << GetStatusName(status) << ':';
+            for (const std::string& word : words) {
+                std::cout << ' ' << word;
+            }
+            std::cout << std::endl;
+        } else if (command == "add"s) {
+            require(3);
+            std::vector<int> ratings;
+            for (int j = i + 3; j < argc; ++j) {
+                ratings.push_back(std::stoi(argv[j]));
+            }
+            client->AddDocument(std::stoi(argv[i]), argv[i + 2], ParseStatus(argv[i + 1]), ratings);
+        } else if (command == "remove"s) {
+            require(1);
+            client->RemoveDocument(std::stoi(argv[i]));
+        } else if (command == "fill"s) {
+            require(1);
+            Fill(*client, std::stoi(argv[i]));
+        } else {
+            throw std::invalid_argument("Unknown command "s + command);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: "s << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../search_server.h"
+#include "../query_server.h"
+#include "../search_metrics.h"
+
+using std::literals::string_literals::operator""s;
+
+/*
+ * Query server around SearchServer, see query_server.h and
+ * query_protocol.h. Documents are added by clients, e.g. search_client.
+ *
+ * Build from the search-server directory:
+ *
+ *  g++ -std=c++17 -O2 -DNDEBUG server/search_daemon.cpp $(ls *.cpp | grep -v main.cpp) \
+ *      -ltbb -lpthread -o search_daemon
+ *
+ * Options:
+ *  --socket PATH        Unix socket to listen on
+ *  --port N             loopback TCP port when there is no socket (0 picks one)
+ *  --workers N          threads executing requests (hardware concurrency)
+ *  --batch N            requests given to a worker at once (64)
+ *  --pending N          requests of a connection in progress before it
+ *                       stops being read (1024)
+ *  --stop-words TEXT    stop words separated by spaces
+ *  --max-in-flight N    searches and matches in progress before new ones
+ *                       are rejected (4096)
+ *  --target-delay-us N  queue delay over which the server is overloaded
+ *                       once it lasts an interval (5000)
+ *  --interval-ms N      CoDel interval (100)
+ *  --degraded-postings N  postings read by a search under overload,
+ *                       0 keeps searches complete (100000)
+ *  --shed 0|1           shed queries under overload (1)
+ *  --metrics PATH       file the admission counters are written to every
+ *                       second in Prometheus text format
+ */
+
+namespace {
+
+QueryServer* running_server = nullptr;
+
+void HandleSignal(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+
+void ExportAdmissionMetrics(const QueryServer& server, const std::string& path) {
+    WriteFileAtomically(path, [&server](std::ostream& out) {
+        server.GetAdmissionController().WritePrometheus(out);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        QueryServerOptions options;
+        std::string stop_words;
+        std::string metrics_path;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Option "s + arg + " requires a value"s);
+            }
+            const std::string value = argv[++i];
+            if (arg == "--socket"s) {
+                options.unix_socket_path = value;
+            } else if (arg == "--port"s) {
+                options.tcp_port = static_cast<uint16_t>(std::stoi(value));
+            } else if (arg == "--workers"s) {
+                options.worker_count = std::max(1, std::stoi(value));
+            } else if (arg == "--batch"s) {
+                options.max_batch_size = std::max(1, std::stoi(value));
+            } else if (arg == "--pending"s) {
+                options.max_pending_requests = std::max(1, std::stoi(value));
+            } else if (arg == "--stop-words"s) {
+                stop_words = value;
+            } else if (arg == "--max-in-flight"s) {
+                options.admission.max_in_flight = std::stoul(value);
+            } else if (arg == "--target-delay-us"s) {
+                options.admission.target_delay = std::chrono::microseconds(std::stoi(value));
+            } else if (arg == "--interval-ms"s) {
+                options.admission.interval = std::chrono::milliseconds(std::max(1, std::stoi(value)));
+            } else if (arg == "--degraded-postings"s) {
+                options.admission.degraded_max_postings = std::stoul(value);
+                options.admission.degrade_when_overloaded = options.admission.degraded_max_postings > 0;
+            } else if (arg == "--shed"s) {
+                options.admission.shed_when_overloaded = std::stoi(value) != 0;
+            } else if (arg == "--metrics"s) {
+                metrics_path = value;
+            } else {
+                throw std::invalid_argument("Unknown option "s + arg);
+            }
+        }
+
+        SearchServer search_server(stop_words);
+        QueryServer server(search_server, options);
+        running_server = &server;
+        std::signal(SIGINT, HandleSignal);
+        std::signal(SIGTERM, HandleSignal);
+        if (options.unix_socket_path.empty()) {
+            std::cerr << "Listening on 127.0.0.1:"s << server.GetPort() << std::endl;
+        } else {
+            std::cerr << "Listening on "s << options.unix_socket_path << std::endl;
+        }
+        std::atomic<bool> is_running = true;
+        std::thread exporter;
+        if (!metrics_path.empty()) {
+            exporter = std::thread([&] {
+                while (is_running.load()) {
+                    try {
+                        ExportAdmissionMetrics(server, metrics_path);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error: "s << e.what() << std::endl;
+                    }
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                }
+            });
+        }
+        const auto stop_exporter = [&] {
+            is_running.store(false);
+            if (exporter.joinable()) {
+                exporter.join();
+            }
+        };
+        try {
+            server.Run();
+        } catch (...) {
+            stop_exporter();
+            throw;
+        }
+        running_server = nullptr;
+        stop_exporter();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: "s << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
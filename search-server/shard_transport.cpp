@@ -0,0 +1,240 @@
+#include "shard_transport.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "wire_format.h"
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+// first value of every response
+enum ResponseStatus {
+    RESPONSE_OK,
+    RESPONSE_ERROR,
+};
+
+void WriteStatistics(WireWriter& writer, const CollectionStatistics& statistics) {
+    writer.WriteInt(statistics.document_count);
+    writer.WriteUint(statistics.document_freqs.size());
+    for (const auto& [word, document_freq] : statistics.document_freqs) {
+        writer.WriteString(word);
+        writer.WriteInt(document_freq);
+    }
+    writer.WriteUint(statistics.prefix_expansions.size());
+    for (const auto& [prefix, words] : statistics.prefix_expansions) {
+        writer.WriteString(prefix);
+        writer.WriteUint(words.size());
+        for (const std::string& word : words) {
+            writer.WriteString(word);
+        }
+    }
+}
+
+CollectionStatistics ReadStatistics(WireReader& reader) {
+    CollectionStatistics statistics;
+    statistics.document_count = static_cast<int>(reader.ReadInt());
+    const uint64_t word_count = reader.ReadUint();
+    for (uint64_t i = 0; i < word_count; ++i) {
+        const std::string_view word = reader.ReadString();
+        statistics.document_freqs.emplace(word, static_cast<int>(reader.ReadInt()));
+    }
+    const uint64_t prefix_count = reader.ReadUint();
+    for (uint64_t i = 0; i < prefix_count; ++i) {
+        auto& words = statistics.prefix_expansions[std::string(reader.ReadString())];
+        const uint64_t expansion_count = reader.ReadUint();
+        for (uint64_t j = 0; j < expansion_count; ++j) {
+            words.emplace_back(reader.ReadString());
+        }
+    }
+    return statistics;
+}
+
+}  // namespace
+
+ShardService::ShardService(SearchServer& search_server)
+    : search_server_(search_server) {
+}
+
+std::string ShardService::Handle(std::string_view request) {
+    WireWriter response;
+    try {
+        WireReader reader(request);
+        WireWriter result;
+        switch (static_cast<ShardRequest>(reader.ReadUint())) {
+        case ShardRequest::ADD_DOCUMENT: {
+            const int document_id = static_cast<int>(reader.ReadInt());
+            const std::string_view document = reader.ReadString();
+            const DocumentStatus status = ReadStatus(reader);
+            // counts come from the wire, elements are added as they are read
+            std::vector<int> ratings;
+            const uint64_t rating_count = reader.ReadUint();
+            for (uint64_t i = 0; i < rating_count; ++i) {
+                ratings.push_back(static_cast<int>(reader.ReadInt()));
+            }
+            search_server_.AddDocument(document_id, document, status, ratings);
+            break;
+        }
+        case ShardRequest::REMOVE_DOCUMENT:
+            search_server_.RemoveDocument(static_cast<int>(reader.ReadInt()));
+            break;
+        case ShardRequest::GET_DOCUMENT_COUNT:
+            result.WriteInt(search_server_.GetDocumentCount());
+            break;
+        case ShardRequest::GET_QUERY_STATISTICS:
+            WriteStatistics(result, search_server_.GetQueryStatistics(reader.ReadString()));
+            break;
+        case ShardRequest::FIND_TOP_DOCUMENTS: {
+            const std::string_view raw_query = reader.ReadString();
+            const DocumentStatus status = ReadStatus(reader);
+            const CollectionStatistics statistics = ReadStatistics(reader);
+            const std::vector<Document> documents = search_server_.FindTopDocuments(raw_query, status, statistics);
+            result.WriteUint(documents.size());
+            for (const Document& document : documents) {
+                result.WriteInt(document.id);
+                result.WriteDouble(document.relevance);
+                result.WriteInt(document.rating);
+            }
+            break;
+        }
+        default:
+            throw std::invalid_argument("Unknown shard request"s);
+        }
+        response.WriteUint(RESPONSE_OK);
+        return response.Release() + result.Release();
+    } catch (const std::exception& e) {
+        response.WriteUint(RESPONSE_ERROR);
+        response.WriteString(e.what());
+        return response.Release();
+    }
+}
+
+LocalShardTransport::LocalShardTransport(ShardService& service)
+    : service_(service) {
+}
+
+std::string LocalShardTransport::Call(const std::string& request) {
+    return service_.Handle(request);
+}
+
+SocketShardTransport::SocketShardTransport(ShardService& service)
+    : service_(service) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        throw std::runtime_error("Can't create a socket pair: "s + std::strerror(errno));
+    }
+    client_fd_ = fds[0];
+    service_fd_ = fds[1];
+    thread_ = std::thread([this] { Serve(); });
+}
+
+SocketShardTransport::~SocketShardTransport() {
+    // the service thread reads the end of the stream and stops
+    shutdown(client_fd_, SHUT_RDWR);
+    thread_.join();
+    close(client_fd_);
+    close(service_fd_);
+}
+
+std::string SocketShardTransport::Call(const std::string& request) {
+    std::string frame;
+    AppendFrame(frame, request);
+    std::lock_guard guard(mutex_);
+    WriteAll(client_fd_, frame);
+    std::string response;
+    if (!ReadFrame(client_fd_, buffer_, response)) {
+        throw std::runtime_error("Shard closed the connection"s);
+    }
+    return response;
+}
+
+void SocketShardTransport::Serve() {
+    std::string buffer;
+    std::string request;
+    try {
+        while (ReadFrame(service_fd_, buffer, request)) {
+            std::string frame;
+            AppendFrame(frame, service_.Handle(request));
+            WriteAll(service_fd_, frame);
+        }
+    } catch (const std::runtime_error&) {
+        // the client side is gone, nobody waits for responses
+    }
+}
+
+ShardClient::ShardClient(ShardTransport& transport)
+    : transport_(transport) {
+}
+
+void ShardClient::AddDocument(int document_id, std::string_view document,
+                              DocumentStatus status, const std::vector<int>& ratings) const {
+    WireWriter request;
+    request.WriteUint(static_cast<uint64_t>(ShardRequest::ADD_DOCUMENT));
+    request.WriteInt(document_id);
+    request.WriteString(document);
+    WriteStatus(request, status);
+    request.WriteUint(ratings.size());
+    for (const int rating : ratings) {
+        request.WriteInt(rating);
+    }
+    Call(request.GetData());
+}
+
+void ShardClient::RemoveDocument(int document_id) const {
+    WireWriter request;
+    request.WriteUint(static_cast<uint64_t>(ShardRequest::REMOVE_DOCUMENT));
+    request.WriteInt(document_id);
+    Call(request.GetData());
+}
+
+int ShardClient::GetDocumentCount() const {
+    WireWriter request;
+    request.WriteUint(static_cast<uint64_t>(ShardRequest::GET_DOCUMENT_COUNT));
+    const std::string response = Call(request.GetData());
+    WireReader reader(response);
+    return static_cast<int>(reader.ReadInt());
+}
+
+CollectionStatistics ShardClient::GetQueryStatistics(std::string_view raw_query) const {
+    WireWriter request;
+    request.WriteUint(static_cast<uint64_t>(ShardRequest::GET_QUERY_STATISTICS));
+    request.WriteString(raw_query);
+    const std::string response = Call(request.GetData());
+    WireReader reader(response);
+    return ReadStatistics(reader);
+}
+
+std::vector<Document> ShardClient::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                    const CollectionStatistics& statistics) const {
+    WireWriter request;
+    request.WriteUint(static_cast<uint64_t>(ShardRequest::FIND_TOP_DOCUMENTS));
+    request.WriteString(raw_query);
+    WriteStatus(request, status);
+    WriteStatistics(request, statistics);
+    const std::string response = Call(request.GetData());
+    WireReader reader(response);
+    std::vector<Document> documents;
+    const uint64_t document_count = reader.ReadUint();
+    for (uint64_t i = 0; i < document_count; ++i) {
+        Document document;
+        document.id = static_cast<int>(reader.ReadInt());
+        document.relevance = reader.ReadDouble();
+        document.rating = static_cast<int>(reader.ReadInt());
+        documents.push_back(document);
+    }
+    return documents;
+}
+
+std::string ShardClient::Call(const std::string& request) const {
+    std::string response = transport_.Call(request);
+    WireReader reader(response);
+    if (reader.ReadUint() == RESPONSE_ERROR) {
+        throw std::invalid_argument(std::string(reader.ReadString()));
+    }
+    // the status takes one byte
+    return response.substr(1);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+enum class ShardRequest {
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    GET_DOCUMENT_COUNT,
+    GET_QUERY_STATISTICS,
+    FIND_TOP_DOCUMENTS,
+};
+
+// Executes encoded requests on one shard. Errors are sent back in the
+// response and thrown again by ShardClient
+class ShardService {
+public:
+    explicit ShardService(SearchServer& search_server);
+
+    std::string Handle(std::string_view request);
+
+private:
+    SearchServer& search_server_;
+};
+
+// Delivers an encoded request to a shard and returns its response.
+// Calls may come from several threads at once
+class ShardTransport {
+public:
+    virtual ~ShardTransport() = default;
+
+    virtual std::string Call(const std::string& request) = 0;
+};
+
+// Calls the service of a shard in the same process
+class LocalShardTransport : public ShardTransport {
+public:
+    explicit LocalShardTransport(ShardService& service);
+
+    std::string Call(const std::string& request) override;
+
+private:
+    ShardService& service_;
+};
+
+// Sends framed requests over a Unix socket pair to a thread serving the
+// shard, as a shard in a separate process would be served. Requests of
+// one transport are executed one at a time
+class SocketShardTransport : public ShardTransport {
+public:
+    explicit SocketShardTransport(ShardService& service);
+    ~SocketShardTransport() override;
+
+    SocketShardTransport(const SocketShardTransport&) = delete;
+    SocketShardTransport& operator=(const SocketShardTransport&) = delete;
+
+    std::string Call(const std::string& request) override;
+
+private:
+    ShardService& service_;
+    int client_fd_ = -1;
+    int service_fd_ = -1;
+    std::mutex mutex_;
+    std::string buffer_;
+    std::thread thread_;
+
+    void Serve();
+};
+
+// Typed requests to a shard
+class ShardClient {
+public:
+    explicit ShardClient(ShardTransport& transport);
+
+    void AddDocument(int document_id, std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings) const;
+    void RemoveDocument(int document_id) const;
+    int GetDocumentCount() const;
+    CollectionStatistics GetQueryStatistics(std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           const CollectionStatistics& statistics) const;
+
+private:
+    ShardTransport& transport_;
+
+    std::string Call(const std::string& request) const;
+};
@@ -0,0 +1,125 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <execution>
+#include <stdexcept>
+
+using std::literals::string_literals::operator""s;
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count,
+                                         ShardTransportType transport_type) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Count of shards must be positive"s);
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        servers_.push_back(std::make_unique<SearchServer>(stop_words_text));
+        services_.push_back(std::make_unique<ShardService>(*servers_.back()));
+        if (transport_type == ShardTransportType::SOCKET) {
+            transports_.push_back(std::make_unique<SocketShardTransport>(*services_.back()));
+        } else {
+            transports_.push_back(std::make_unique<LocalShardTransport>(*services_.back()));
+        }
+        clients_.emplace_back(*transports_.back());
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document,
+                                      DocumentStatus status, const std::vector<int>& ratings) {
+    clients_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    clients_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                            DocumentStatus status) const {
+    std::vector<CollectionStatistics> shard_statistics(clients_.size());
+    std::transform(std::execution::par,
+                   clients_.begin(), clients_.end(),
+                   shard_statistics.begin(),
+                   [raw_query](const ShardClient& client) {
+                       return client.GetQueryStatistics(raw_query);
+                   });
+
+    CollectionStatistics statistics;
+    for (const CollectionStatistics& shard : shard_statistics) {
+        statistics.document_count += shard.document_count;
+        for (const auto& [word, document_freq] : shard.document_freqs) {
+            statistics.document_freqs[word] += document_freq;
+        }
+        for (const auto& [prefix, words] : shard.prefix_expansions) {
+            auto& expansions = statistics.prefix_expansions[prefix];
+            expansions.insert(expansions.end(), words.begin(), words.end());
+        }
+    }
+    // the shards give all their words with a prefix, the limit keeps the
+    // words most frequent in the collection
+    for (auto& [prefix, words] : statistics.prefix_expansions) {
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+        std::vector<std::pair<size_t, std::string_view>> expansions;
+        expansions.reserve(words.size());
+        for (const std::string& word : words) {
+            expansions.push_back({static_cast<size_t>(statistics.document_freqs.at(word)), word});
+        }
+        SearchServer::SelectPrefixExpansions(expansions, prefix_expansion_limit_);
+        std::vector<std::string> chosen_words;
+        chosen_words.reserve(expansions.size());
+        for (const auto& expansion : expansions) {
+            chosen_words.emplace_back(expansion.second);
+        }
+        words = std::move(chosen_words);
+    }
+
+    std::vector<std::vector<Document>> shard_documents(clients_.size());
+    std::transform(std::execution::par,
+                   clients_.begin(), clients_.end(),
+                   shard_documents.begin(),
+                   [raw_query, status, &statistics](const ShardClient& client) {
+                       return client.FindTopDocuments(raw_query, status, statistics);
+                   });
+
+    // the top of the collection is among the tops of the shards
+    std::vector<Document> documents;
+    for (const auto& shard : shard_documents) {
+        documents.insert(documents.end(), shard.begin(), shard.end());
+    }
+    std::sort(documents.begin(), documents.end(), SearchServer::IsRankedBefore);
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return documents;
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const ShardClient& client : clients_) {
+        document_count += client.GetDocumentCount();
+    }
+    return document_count;
+}
+
+void ShardedSearchServer::SetPrefixExpansionLimit(size_t limit) {
+    if (limit == 0) {
+        throw std::invalid_argument("Prefix expansion limit must be positive"s);
+    }
+    prefix_expansion_limit_ = limit;
+}
+
+size_t ShardedSearchServer::GetPrefixExpansionLimit() const {
+    return prefix_expansion_limit_;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return clients_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // splitmix64 finalizer, so that sequential ids are spread evenly
+    uint64_t hash = static_cast<uint64_t>(static_cast<uint32_t>(document_id)) + 0x9e3779b97f4a7c15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return static_cast<size_t>(hash % clients_.size());
+}
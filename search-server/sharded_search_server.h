@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "shard_transport.h"
+
+enum class ShardTransportType {
+    LOCAL,      // shards are called directly
+    SOCKET,     // shards are served over Unix sockets
+};
+
+// Documents are spread over shards by a hash of their id. A query is
+// sent to all shards in parallel twice: first for document frequencies
+// of its words and all the words with its prefixes, then for the top
+// documents ranked with the frequencies of the whole collection and
+// prefixes expanded to the words most frequent in it. Merged results are
+// the same as the results of one SearchServer with all the documents
+// and the same prefix expansion limit
+class ShardedSearchServer {
+public:
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count,
+                        ShardTransportType transport_type = ShardTransportType::LOCAL);
+
+    void AddDocument(int document_id, std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    int GetDocumentCount() const;
+
+    // As in SearchServer, applied to the whole collection
+    void SetPrefixExpansionLimit(size_t limit);
+    size_t GetPrefixExpansionLimit() const;
+
+    size_t GetShardCount() const;
+
+    size_t GetShardIndex(int document_id) const;
+
+private:
+    // members are destroyed in reverse order: clients and transports
+    // are gone before the servers they call
+    std::vector<std::unique_ptr<SearchServer>> servers_;
+    std::vector<std::unique_ptr<ShardService>> services_;
+    std::vector<std::unique_ptr<ShardTransport>> transports_;
+    std::vector<ShardClient> clients_;
+    size_t prefix_expansion_limit_ = DEFAULT_PREFIX_EXPANSION_LIMIT;
+};
@@ -0,0 +1,94 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+void AppendVarint(std::string& data, size_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<char>(value));
+}
+
+size_t ReadVarint(const std::string& data, size_t& offset) {
+    size_t value = 0;
+    int shift = 0;
+    while (true) {
+        const uint8_t byte = static_cast<uint8_t>(data[offset++]);
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+}  // namespace
+
+std::string FrontCodedDictionary::GetWord(size_t id) const {
+    if (id >= size_) {
+        throw std::out_of_range("No word with id "s + std::to_string(id));
+    }
+    std::string word;
+    size_t offset = block_offsets_[id / BLOCK_SIZE];
+    for (size_t i = id - id % BLOCK_SIZE; i <= id; ++i) {
+        offset = DecodeNext(offset, i % BLOCK_SIZE == 0, word);
+    }
+    return word;
+}
+
+size_t FrontCodedDictionary::GetPayloadBytes() const {
+    return data_.size() + block_offsets_.size() * sizeof(uint32_t);
+}
+
+size_t FrontCodedDictionary::GetCapacityBytes() const {
+    return data_.capacity() + block_offsets_.capacity() * sizeof(uint32_t);
+}
+
+void FrontCodedDictionary::Add(std::string_view word, std::string_view previous) {
+    if (size_ % BLOCK_SIZE == 0) {
+        block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+        AppendVarint(data_, word.size());
+        data_.append(word);
+    } else {
+        const size_t max_shared = std::min(word.size(), previous.size());
+        size_t shared = 0;
+        while (shared < max_shared && word[shared] == previous[shared]) {
+            ++shared;
+        }
+        AppendVarint(data_, shared);
+        AppendVarint(data_, word.size() - shared);
+        data_.append(word.substr(shared));
+    }
+    ++size_;
+}
+
+size_t FrontCodedDictionary::FindBlock(std::string_view word) const {
+    size_t first = 0;
+    size_t last = block_offsets_.size();
+    std::string head;
+    // binary search of the first block whose first word isn't less than word
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        DecodeNext(block_offsets_[middle], true, head);
+        if (head < word) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first == 0 ? 0 : first - 1;
+}
+
+size_t FrontCodedDictionary::DecodeNext(size_t offset, bool is_block_start, std::string& word) const {
+    const size_t shared = is_block_start ? 0 : ReadVarint(data_, offset);
+    const size_t rest = ReadVarint(data_, offset);
+    word.resize(shared);
+    word.append(data_, offset, rest);
+    return offset + rest;
+}
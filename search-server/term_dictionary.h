@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable sorted dictionary of words with front coding: words are
+// split into blocks of BLOCK_SIZE, the first word of a block is stored
+// whole and every next word as the length of the prefix shared with the
+// previous word and the rest of it. Ids of words are their indexes in
+// the sorted order, so words with a common prefix get a range of ids
+class FrontCodedDictionary {
+public:
+    static constexpr size_t BLOCK_SIZE = 16;
+
+    FrontCodedDictionary() = default;
+
+    // words must be sorted and unique
+    template <typename StringContainer>
+    explicit FrontCodedDictionary(const StringContainer& words);
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+    std::string GetWord(size_t id) const;
+
+    // Calls callback(id, word) for every word starting with prefix in
+    // ascending order, the callback may return false to stop
+    template <typename Callback>
+    void ForEachWithPrefix(std::string_view prefix, Callback callback) const;
+
+    // Bytes of the encoded words and of the block offsets
+    size_t GetPayloadBytes() const;
+    size_t GetCapacityBytes() const;
+
+private:
+    std::string data_;
+    std::vector<uint32_t> block_offsets_;
+    size_t size_ = 0;
+
+    void Add(std::string_view word, std::string_view previous);
+
+    // index of the last block whose first word is less than word
+    // (the first block if there isn't such)
+    size_t FindBlock(std::string_view word) const;
+
+    // Decodes the word at offset over the previous word, returns the
+    // offset of the next word
+    size_t DecodeNext(size_t offset, bool is_block_start, std::string& word) const;
+};
+
+template <typename StringContainer>
+FrontCodedDictionary::FrontCodedDictionary(const StringContainer& words) {
+    std::string_view previous;
+    for (const std::string_view word : words) {
+        Add(word, previous);
+        previous = word;
+    }
+    data_.shrink_to_fit();
+    block_offsets_.shrink_to_fit();
+}
+
+template <typename Callback>
+void FrontCodedDictionary::ForEachWithPrefix(std::string_view prefix, Callback callback) const {
+    if (size_ == 0) {
+        return;
+    }
+    std::string word;
+    size_t id = FindBlock(prefix) * BLOCK_SIZE;
+    size_t offset = block_offsets_[id / BLOCK_SIZE];
+    for (; id < size_; ++id) {
+        offset = DecodeNext(offset, id % BLOCK_SIZE == 0, word);
+        if (word < prefix) {
+            continue;
+        }
+        if (word.compare(0, prefix.size(), prefix) != 0 || !callback(id, std::string_view(word))) {
+            return;
+        }
+    }
+}
@@ -1,5 +1,11 @@
 #include "test_example_functions.h"
 
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#include "wire_format.h"
+
 void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
                 const std::string& hint) {
     if (!value) {
@@ -223,6 +229,1187 @@ void TestCorrectRelevanceDocument() {
     }
 }
 
+void TestDuplicatePolicy() {
+    {
+        SearchServer server("and with"s);
+        server.SetDuplicatePolicy(DuplicatePolicy::DETECT);
+        server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(3, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(4, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocument(5, "curly hair with funny pet"s, DocumentStatus::ACTUAL, {1, 2});
+        ASSERT_EQUAL(server.GetDocumentCount(), 5);
+        ASSERT_HINT((server.GetDuplicateDocuments() == std::vector<int>{3, 5}), "Documents with the same words must be detected"s);
+
+        server.RemoveDocument(1);
+        ASSERT_HINT((server.GetDuplicateDocuments() == std::vector<int>{5}), "Removed original must make its copy unique"s);
+    }
+
+    {
+        SearchServer server("and with"s);
+        server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        server.SetDuplicatePolicy(DuplicatePolicy::REJECT);
+        bool rejected = false;
+        try {
+            server.AddDocument(2, "rat nasty pet funny"s, DocumentStatus::ACTUAL, {1, 2});
+        } catch (const std::invalid_argument&) {
+            rejected = true;
+        }
+        ASSERT_HINT(rejected, "Duplicate must be rejected"s);
+        ASSERT_EQUAL(server.GetDocumentCount(), 1);
+
+        server.RemoveDocument(1);
+        server.AddDocument(2, "rat nasty pet funny"s, DocumentStatus::ACTUAL, {1, 2});
+        ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    }
+}
+
+void TestNearDuplicates() {
+    SearchServer server(""s);
+    server.AddDocument(1, "buy cheap pills online now best price guaranteed fast shipping today"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "buy cheap pills online now best price guaranteed fast shipping tonight"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(3, "fluffy cat with fluffy tail sleeps on a warm sofa"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(4, "buy cheap pills online now best price guaranteed fast shipping today"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(5, "kind dog expressive eyes"s, DocumentStatus::ACTUAL, {1});
+
+    NearDuplicateOptions options;
+    options.jaccard_threshold = 0.8;
+    const auto groups = FindNearDuplicates(server, options);
+    ASSERT_EQUAL(groups.size(), 1u);
+    ASSERT_HINT((groups[0] == std::vector<int>{1, 2, 4}), "Documents differing by one word must be grouped"s);
+
+    options.jaccard_threshold = 1.0;
+    const auto exact_groups = FindNearDuplicates(server, options);
+    ASSERT_EQUAL(exact_groups.size(), 1u);
+    ASSERT_HINT((exact_groups[0] == std::vector<int>{1, 4}), "Threshold must be applied to exact Jaccard"s);
+
+    // 10 like 11 and 11 like 12, but 12 isn't like 10: 12 stays
+    SearchServer chain_server(""s);
+    chain_server.AddDocument(10, "w1 w2 w3 w4 w5 w6 w7 w8 w9 w10"s, DocumentStatus::ACTUAL, {1});
+    chain_server.AddDocument(11, "w1 w2 w3 w4 w5 w6 w7 w8 w9 w10 w11"s, DocumentStatus::ACTUAL, {1});
+    chain_server.AddDocument(12, "w1 w2 w3 w4 w5 w6 w7 w8 w9 w10 w11 w12"s, DocumentStatus::ACTUAL, {1});
+    options.jaccard_threshold = 0.85;
+    const auto chain_groups = FindNearDuplicates(chain_server, options);
+    ASSERT_EQUAL(chain_groups.size(), 1u);
+    ASSERT_HINT((chain_groups[0] == std::vector<int>{10, 11}), "Members of a group must be similar to its first document"s);
+    RemoveNearDuplicates(chain_server, options);
+    ASSERT_EQUAL(chain_server.GetDocumentCount(), 2);
+    ASSERT_EQUAL(chain_server.FindTopDocuments("w12"s).size(), 1u);
+
+    // a bucket larger than the limit is still compared with its first documents
+    SearchServer spam_server(""s);
+    for (int id = 0; id < 30; ++id) {
+        spam_server.AddDocument(id, "buy cheap pills online now"s, DocumentStatus::ACTUAL, {1});
+    }
+    options.max_bucket_size = 4;
+    const auto spam_groups = FindNearDuplicates(spam_server, options);
+    ASSERT_EQUAL(spam_groups.size(), 1u);
+    ASSERT_EQUAL(spam_groups[0].size(), 30u);
+}
+
+void TestConcurrentRequestQueue() {
+    SearchServer server("and in at"s);
+    server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "big dog sparrow Eugene"s, DocumentStatus::ACTUAL, {1, 3, 2});
+    ConcurrentRequestQueue request_queue(server, std::chrono::hours(1), 60);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&request_queue] {
+            for (int i = 0; i < 100; ++i) {
+                request_queue.AddFindRequest(i % 4 == 0 ? "empty request"s : "curly dog"s);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    request_queue.AddFindRequest("sparrow"s, DocumentStatus::BANNED);
+
+    const auto statistics = request_queue.GetStatistics();
+    ASSERT_EQUAL(statistics.requests, 401u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 101);
+    ASSERT(statistics.queries_per_second > 0);
+    ASSERT(statistics.latency_p50_ns <= statistics.latency_p99_ns);
+
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.Record(value);
+    }
+    LatencyHistogram::Counts counts{};
+    histogram.AddTo(counts);
+    const uint64_t median = LatencyHistogram::ComputePercentile(counts, 50.0);
+    ASSERT_HINT(median >= 500 && median < 500 + 500 / LatencyHistogram::SUB_BUCKET_COUNT, "Percentile must be within bucket precision"s);
+}
+
+void TestSearchAfterPagination() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 20; ++id) {
+        std::string text = "cat"s;
+        for (int i = 0; i < id % 7; ++i) {
+            text += " dog"s;
+        }
+        server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 3});
+    }
+    server.AddDocument(20, "parrot"s, DocumentStatus::ACTUAL, {1});
+
+    const auto top = server.FindTopDocuments("cat"s);
+    std::vector<Document> all_pages;
+    std::optional<SearchCursor> cursor;
+    do {
+        const SearchPage page = server.FindDocumentsAfter("cat"s, cursor, 3);
+        ASSERT(!page.documents.empty() && page.documents.size() <= 3u);
+        all_pages.insert(all_pages.end(), page.documents.begin(), page.documents.end());
+        cursor = page.next_cursor;
+    } while (cursor);
+
+    ASSERT_EQUAL(all_pages.size(), 16u);
+    for (size_t i = 0; i < top.size(); ++i) {
+        ASSERT_EQUAL_HINT(all_pages[i].id, top[i].id, "The first pages must match FindTopDocuments"s);
+    }
+    std::set<int> ids;
+    for (size_t i = 0; i < all_pages.size(); ++i) {
+        ids.insert(all_pages[i].id);
+        if (i > 0) {
+            ASSERT_HINT(all_pages[i - 1].relevance + PRECISION > all_pages[i].relevance, "Pages must continue the ranking"s);
+        }
+    }
+    ASSERT_EQUAL_HINT(ids.size(), all_pages.size(), "Pages must not overlap"s);
+}
+
+void TestForEachMatch() {
+    SearchServer server("and with"s);
+    for (int id = 100; id > 0; --id) {
+        const std::string text = (id % 2 == 0 ? "curly cat"s : "nasty dog"s) + (id % 3 == 0 ? " rat"s : ""s);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    const auto any_document = [](int, DocumentStatus, int) { return true; };
+
+    std::vector<Document> visited;
+    const bool finished = server.ForEachMatch("cat rat -dog"s, any_document, [&visited](int id, double relevance, int rating) {
+        visited.push_back({id, relevance, rating});
+    });
+    ASSERT(finished);
+    ASSERT_EQUAL(visited.size(), 50u);
+    for (size_t i = 0; i < visited.size(); ++i) {
+        ASSERT_EQUAL_HINT(visited[i].id, static_cast<int>(2 * i + 2), "Matches must be visited in ascending order of id"s);
+    }
+    const auto top = server.FindTopDocuments("cat rat -dog"s);
+    const auto top_it = std::find_if(visited.begin(), visited.end(), [&top](const Document& d) { return d.id == top[0].id; });
+    ASSERT(top_it != visited.end() && std::abs(top_it->relevance - top[0].relevance) < PRECISION);
+
+    int visited_count = 0;
+    const bool stopped = !server.ForEachMatch("cat"s, any_document, [&visited_count](int, double, int) {
+        return ++visited_count < 10;
+    });
+    ASSERT_HINT(stopped && visited_count == 10, "Visitor must be able to stop the search"s);
+
+    std::atomic<int> parallel_count = 0;
+    server.ForEachMatch(std::execution::par, "cat rat -dog"s, any_document, [&parallel_count](int, double, int) {
+        ++parallel_count;
+    });
+    ASSERT_EQUAL(parallel_count.load(), 50);
+}
+
+void TestSearchMetrics() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.FindTopDocuments("curly"s);
+    ASSERT_HINT(server.GetMetrics().GetSnapshot(SearchStage::PARSE_QUERY).count == 0, "Disabled metrics must not record"s);
+
+    server.GetMetrics().SetEnabled(true);
+    server.AddDocument(2, "nasty dog with big eyes"s, DocumentStatus::ACTUAL, {1, 2});
+    server.FindTopDocuments("curly -dog"s);
+    server.FindTopDocuments(std::execution::par, "curly -dog"s);
+    const SearchMetrics& metrics = server.GetMetrics();
+    ASSERT_EQUAL(metrics.GetSnapshot(SearchStage::ADD_DOCUMENT).count, 1u);
+    ASSERT_EQUAL(metrics.GetSnapshot(SearchStage::PARSE_QUERY).count, 2u);
+    ASSERT_EQUAL(metrics.GetSnapshot(SearchStage::SELECT_TOP).count, 2u);
+    ASSERT_EQUAL(metrics.GetSnapshot(SearchStage::FILTER_MINUS_WORDS).count, 1u);
+
+    std::ostringstream out;
+    metrics.WritePrometheus(out);
+    const std::string text = out.str();
+    ASSERT(text.find("# TYPE search_server_stage_duration_seconds histogram"s) != std::string::npos);
+    ASSERT(text.find("search_server_stage_duration_seconds_count{stage=\"parse_query\"} 2\n"s) != std::string::npos);
+    ASSERT(text.find("search_server_stage_duration_seconds_bucket{stage=\"add_document\",le=\"+Inf\"} 1\n"s) != std::string::npos);
+}
+
+void TestExplainTopDocuments() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(3, "nasty dog with big eyes"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(4, "nasty pigeon john"s, DocumentStatus::BANNED, {1, 2});
+    server.AddDocument(5, "nasty cat"s, DocumentStatus::ACTUAL, {1, 2});
+
+    const std::string query = "curly nasty cat -dog parrot"s;
+    const auto [documents, trace] = server.ExplainTopDocuments(query);
+    const auto expected = server.FindTopDocuments(query);
+    ASSERT_EQUAL(documents.size(), expected.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_EQUAL(documents[i].id, expected[i].id);
+    }
+
+    ASSERT_EQUAL(trace.terms.size(), 5u);
+    const auto nasty = std::find_if(trace.terms.begin(), trace.terms.end(), [](const QueryTrace::Term& term) {
+        return term.word == "nasty"s;
+    });
+    ASSERT(nasty != trace.terms.end() && !nasty->is_minus);
+    ASSERT_EQUAL(nasty->document_freq, 3u);
+    ASSERT(std::abs(nasty->inverse_document_freq - log(5.0 / 3.0)) < PRECISION);
+
+    // the status query reads only postings of ACTUAL documents
+    ASSERT_EQUAL(trace.candidate_documents, 4u);
+    ASSERT_EQUAL(trace.rejected_by_minus_words, 1u);
+    ASSERT_EQUAL(trace.rejected_by_predicate, 0u);
+    ASSERT_EQUAL(trace.matched_documents, 3u);
+    ASSERT(trace.postings_scanned >= 6u);
+
+    const auto [predicate_documents, predicate_trace] = server.ExplainTopDocuments(query,
+        [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL;
+        });
+    ASSERT_EQUAL(predicate_documents.size(), documents.size());
+    ASSERT_EQUAL(predicate_trace.candidate_documents, 5u);
+    ASSERT_EQUAL(predicate_trace.rejected_by_minus_words, 1u);
+    ASSERT_EQUAL(predicate_trace.rejected_by_predicate, 1u);
+    ASSERT_EQUAL(predicate_trace.matched_documents, 3u);
+    ASSERT(predicate_trace.postings_scanned >= 7u);
+}
+
+void TestRequestQueueLog() {
+    SearchServer server("and in at"s);
+    server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    RequestQueue request_queue(server);
+    std::stringstream log;
+    request_queue.AddFindRequest("not logged"s);
+    request_queue.SetQueryLog(&log);
+    request_queue.AddFindRequest("curly dog"s);
+    request_queue.AddFindRequest("empty request"s);
+    request_queue.SetQueryLog(nullptr);
+    request_queue.AddFindRequest("curly"s);
+
+    const auto records = ReadQueryLog(log);
+    ASSERT_EQUAL(records.size(), 2u);
+    ASSERT_EQUAL(records[0].query, "curly dog"s);
+    ASSERT_EQUAL(records[0].results, 1u);
+    ASSERT_EQUAL(records[1].query, "empty request"s);
+    ASSERT_EQUAL(records[1].results, 0u);
+    ASSERT(records[0].offset_us <= records[1].offset_us);
+}
+
+void TestMemoryStats() {
+    SearchServer server("and with"s);
+    const IndexMemoryStats empty_stats = server.GetMemoryStats();
+    ASSERT_EQUAL(empty_stats.term_dictionary.entries, 0u);
+    ASSERT_EQUAL(empty_stats.stop_words.entries, 2u);
+
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(3, "nasty cat with big eyes"s, DocumentStatus::ACTUAL, {1, 2});
+
+    const IndexMemoryStats stats = server.GetMemoryStats();
+    ASSERT_EQUAL(stats.term_dictionary.entries, 9u);
+    ASSERT_EQUAL(stats.term_dictionary.payload_bytes, 38u);
+    ASSERT_EQUAL(stats.postings.entries, 11u);
+    ASSERT_EQUAL(stats.forward_index.entries, 11u);
+    ASSERT_EQUAL(stats.documents.entries, 3u);
+    ASSERT(stats.postings.overhead_bytes > 0);
+    ASSERT(stats.GetTotalBytes() > empty_stats.GetTotalBytes());
+
+    // "cat" is in 3 documents, the other words are in one
+    ASSERT_EQUAL(stats.posting_length_histogram.size(), 3u);
+    ASSERT_EQUAL(stats.posting_length_histogram[1], 8u);
+    ASSERT_EQUAL(stats.posting_length_histogram[2], 1u);
+
+    // the dictionary, the postings and the documents are in the arena
+    ASSERT(stats.index_arena.chunk_count > 0);
+    ASSERT(stats.index_arena.used_bytes > 0);
+    ASSERT(stats.index_arena.reserved_bytes >= stats.index_arena.used_bytes);
+    ASSERT(stats.GetTotalBytes() >= stats.index_arena.reserved_bytes);
+
+    server.RemoveDocument(2);
+    ASSERT_EQUAL(server.GetMemoryStats().documents.entries, 2u);
+    ASSERT(server.GetMemoryStats().postings.entries < stats.postings.entries);
+    ASSERT(server.GetMemoryStats().index_arena.used_bytes < stats.index_arena.used_bytes);
+
+    // estimates of containers in an arena are its blocks: size classes
+    // of 16 bytes without headers
+    IndexArena arena;
+    {
+        std::pmr::map<int, std::pmr::string> words(&arena);
+        words.emplace(1, "cat");
+        words.emplace(2, "a word longer than the short string buffer");
+        ASSERT_EQUAL(arena.GetUsedBytes(), 2 * EstimateArenaTreeNodeSize(sizeof(std::pair<const int, std::pmr::string>))
+            + EstimateArenaStringHeapSize(words.at(2)));
+        ASSERT_EQUAL(EstimateArenaStringHeapSize(words.at(1)), 0u);
+    }
+    ASSERT_EQUAL(arena.GetUsedBytes(), 0u);
+    ASSERT_EQUAL(EstimateArenaAllocationSize(33), 48u);
+    ASSERT_EQUAL(EstimateArenaAllocationSize(48), 48u);
+    ASSERT_EQUAL(EstimateArenaAllocationSize(IndexArena::MAX_POOLED_SIZE + 1), IndexArena::MAX_POOLED_SIZE + 1);
+}
+
+void TestTermCountRelevance() {
+    // documents with repeated words, relevance is compared with the one
+    // computed from TF summed as 1.0 / word count per occurrence
+    const std::vector<std::string> words = {"cat"s, "dog"s, "tail"s, "hat"s, "eyes"s, "collar"s, "curly"s};
+    std::vector<std::string> texts;
+    uint32_t state = 17;
+    for (int id = 0; id < 50; ++id) {
+        std::string text;
+        const int length = 1 + id % 13;
+        for (int i = 0; i < length; ++i) {
+            state = state * 1103515245u + 12345u;
+            text += words[(state >> 16) % words.size()] + " "s;
+        }
+        texts.push_back(text);
+    }
+    SearchServer server(""s);
+    std::map<std::string_view, std::map<int, double>> word_to_document_freqs;
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id});
+        const std::vector<std::string_view> document_words = SplitIntoWords(texts[id]);
+        for (const std::string_view word : document_words) {
+            word_to_document_freqs[word][id] += 1.0 / document_words.size();
+        }
+    }
+
+    for (const std::string& query : {"cat"s, "curly dog"s, "hat eyes collar -tail"s, "cat dog tail hat eyes collar curly"s}) {
+        std::map<int, double> expected;
+        for (const std::string_view word : SplitIntoWords(query)) {
+            if (word[0] == '-') {
+                continue;
+            }
+            const auto& postings = word_to_document_freqs.at(word);
+            const double inverse_document_freq = log(texts.size() * 1.0 / postings.size());
+            for (const auto [id, term_freq] : postings) {
+                expected[id] += term_freq * inverse_document_freq;
+            }
+        }
+        for (const auto& documents : {server.FindTopDocuments(query), server.FindTopDocuments(std::execution::par, query)}) {
+            ASSERT(!documents.empty());
+            for (const Document& document : documents) {
+                ASSERT(std::abs(document.relevance - expected.at(document.id)) < PRECISION);
+            }
+        }
+    }
+}
+
+void TestPhraseQueries() {
+    SearchServer server("and the"s);
+    server.SetPositionalIndex(true);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "yellow cat with white hat"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "white fluffy cat white cat"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "the cat"s, DocumentStatus::ACTUAL, {4});
+
+    const auto ids = [&server](const std::string& query) {
+        std::set<int> result;
+        for (const Document& document : server.FindTopDocuments(query)) {
+            result.insert(document.id);
+        }
+        std::set<int> par_result;
+        for (const Document& document : server.FindTopDocuments(std::execution::par, query)) {
+            par_result.insert(document.id);
+        }
+        ASSERT(result == par_result);
+        return result;
+    };
+    ASSERT(ids("\"white cat\""s) == std::set<int>({1, 3}));
+    ASSERT(ids("\"white hat\""s) == std::set<int>({2}));
+    ASSERT(ids("\"cat yellow hat\""s) == std::set<int>({1}));
+    ASSERT(ids("\"white cat\"~1 -yellow"s) == std::set<int>({3}));
+    ASSERT(ids("\"yellow white\"~2"s) == std::set<int>({2}));
+    ASSERT(ids("\"cat white\"~5"s) == std::set<int>({2, 3}));
+    // stop words are not counted in positions
+    ASSERT(ids("\"cat the yellow\""s) == std::set<int>({1}));
+    ASSERT(ids("\"white cat\" hat"s) == std::set<int>({1, 3}));
+
+    const auto [words, status] = server.MatchDocument("\"white hat\""s, 1);
+    ASSERT(words.empty());
+    const auto [trace_documents, trace] = server.ExplainTopDocuments("\"white cat\""s);
+    ASSERT_EQUAL(trace.rejected_by_phrases, 2u);
+
+    try {
+        server.FindTopDocuments("\"white cat"s);
+        ASSERT_HINT(false, "Not closed phrase must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+    try {
+        server.FindTopDocuments("\"white cat\"~x"s);
+        ASSERT_HINT(false, "Wrong proximity must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    server.RemoveDocument(3);
+    ASSERT(ids("\"white cat\""s) == std::set<int>({1}));
+    ASSERT(server.GetMemoryStats().positions.entries > 0);
+
+    SearchServer plain_server(""s);
+    plain_server.AddDocument(1, "\"quoted\" word"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(plain_server.FindTopDocuments("\"quoted\""s).size(), 1u);
+    try {
+        plain_server.SetPositionalIndex(true);
+        ASSERT_HINT(false, "Positional index of a non-empty server must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestPrefixQueries() {
+    std::vector<std::string> words;
+    for (int i = 0; i < 100; ++i) {
+        words.push_back("word"s + std::to_string(i));
+    }
+    std::sort(words.begin(), words.end());
+    const FrontCodedDictionary dictionary(words);
+    ASSERT_EQUAL(dictionary.GetSize(), words.size());
+    for (size_t id = 0; id < words.size(); ++id) {
+        ASSERT_EQUAL(dictionary.GetWord(id), words[id]);
+    }
+    std::vector<std::string> prefixed;
+    dictionary.ForEachWithPrefix("word4"s, [&prefixed, &words](size_t id, std::string_view word) {
+        ASSERT_EQUAL(words[id], word);
+        prefixed.push_back(std::string(word));
+        return true;
+    });
+    ASSERT_EQUAL(prefixed.size(), 11u);
+    ASSERT(dictionary.GetPayloadBytes() < 100 * 6);
+
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat and catalog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "category of cats"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "cats cats cats"s, DocumentStatus::ACTUAL, {4});
+    ASSERT_EQUAL(server.FindTopDocuments("cat*"s).size(), 3u);
+    ASSERT_EQUAL(server.FindTopDocuments("dog -cat*"s).size(), 1u);
+    ASSERT(server.FindTopDocuments("catz*"s).empty());
+
+    // prefix query scores as the query of all its words
+    const auto prefix_documents = server.FindTopDocuments("cata*"s);
+    const auto word_documents = server.FindTopDocuments("catalog"s);
+    ASSERT_EQUAL(prefix_documents.size(), 1u);
+    ASSERT(std::abs(prefix_documents[0].relevance - word_documents[0].relevance) < PRECISION);
+
+    // words added after the first prefix query are found too
+    server.AddDocument(5, "catfish"s, DocumentStatus::ACTUAL, {5});
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "cat*"s).size(), 4u);
+
+    // with the limit of one word, only "cats" from two documents is left
+    server.SetPrefixExpansionLimit(1);
+    const auto [documents, trace] = server.ExplainTopDocuments("cat*"s);
+    ASSERT_EQUAL(trace.terms.size(), 1u);
+    ASSERT_EQUAL(trace.terms[0].word, "cats"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT(server.GetMemoryStats().prefix_dictionary.entries > 0);
+
+    try {
+        server.FindTopDocuments("*"s);
+        ASSERT_HINT(false, "Empty prefix must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestMatchDocuments() {
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::BANNED, {7, 2, 7});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {5, -12, 2});
+    server.AddDocument(4, "white dog in collar"s, DocumentStatus::ACTUAL, {1});
+
+    const std::string raw_query = "fluffy white cat collar -dog"s;
+    const std::vector<int> ids = {4, 1, 2, 3};
+    const auto results = server.MatchDocuments(raw_query, ids);
+    ASSERT_EQUAL(results.size(), ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ASSERT(results[i] == server.MatchDocument(raw_query, ids[i]));
+        ASSERT(results[i] == server.MatchDocument(std::execution::par, raw_query, ids[i]));
+    }
+    ASSERT(std::get<0>(results[0]).empty());
+    ASSERT((std::get<0>(results[1]) == std::vector<std::string_view>{"cat", "collar", "white"}));
+    ASSERT((std::get<0>(results[2]) == std::vector<std::string_view>{"cat", "fluffy"}));
+    ASSERT(std::get<1>(results[2]) == DocumentStatus::BANNED);
+
+    // matched words are views of the index, not of the query
+    std::string query = "collar white"s;
+    const auto [words, status] = server.MatchDocument(query, 4);
+    query.assign(query.size(), '#');
+    ASSERT((words == std::vector<std::string_view>{"collar", "white"}));
+
+    try {
+        server.MatchDocuments("cat"s, {1, 5});
+        ASSERT_HINT(false, "Missing documents must throw"s);
+    } catch (const std::out_of_range&) {
+    }
+}
+
+void TestForwardIndex() {
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and white collar"s, DocumentStatus::ACTUAL, {8});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(3, "dog with collar"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(4, "white dog in the dark"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(5, "old cat"s, DocumentStatus::ACTUAL, {2});
+
+    const auto to_map = [](const WordFrequencies& word_freqs) {
+        return std::map<std::string_view, double>(word_freqs.begin(), word_freqs.end());
+    };
+    const std::map<std::string_view, double> expected = {{"cat", 0.25}, {"collar", 0.25}, {"white", 0.5}};
+    ASSERT(to_map(server.GetWordFrequencies(1)) == expected);
+    ASSERT(server.GetWordFrequencies(6).empty());
+
+    // removed documents leave ranges in the buffer until it is compacted
+    server.RemoveDocument(2);
+    server.RemoveDocument(std::execution::par, 4);
+    server.RemoveDocument(3);
+    ASSERT(to_map(server.GetWordFrequencies(1)) == expected);
+    ASSERT_EQUAL(server.GetWordFrequencies(5).size(), 2u);
+    ASSERT_EQUAL(server.GetMemoryStats().forward_index.entries, 5u);
+    ASSERT(server.FindTopDocuments("fluffy dog"s).empty());
+
+    // a query-only replica keeps the results without the forward index
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    const auto documents = server.FindTopDocuments("fluffy white cat"s);
+    const auto match = server.MatchDocument("white cat -tail"s, 1);
+    server.SetForwardIndex(false);
+    ASSERT(!server.HasForwardIndex());
+    ASSERT(server.GetWordFrequencies(1).empty());
+    ASSERT_EQUAL(server.GetMemoryStats().forward_index.GetTotalBytes(), 0u);
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy white cat"s).size(), documents.size());
+    ASSERT(server.MatchDocument("white cat -tail"s, 1) == match);
+    ASSERT(std::get<0>(server.MatchDocument("white cat -tail"s, 2)).empty());
+    try {
+        server.SetDuplicatePolicy(DuplicatePolicy::DETECT);
+        ASSERT_HINT(false, "Duplicate tracking without the forward index must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+    server.RemoveDocument(5);
+    server.AddDocument(6, "white collar"s, DocumentStatus::ACTUAL, {});
+
+    server.SetForwardIndex(true);
+    ASSERT(to_map(server.GetWordFrequencies(1)) == expected);
+    ASSERT((to_map(server.GetWordFrequencies(6)) == std::map<std::string_view, double>{{"collar", 0.5}, {"white", 0.5}}));
+    ASSERT(server.GetWordFrequencies(5).empty());
+    ASSERT(server.MatchDocument("white cat -tail"s, 1) == match);
+    ASSERT_EQUAL(server.GetMemoryStats().forward_index.entries, 8u);
+}
+
+void TestDocumentBitmap() {
+    // sparse ids go to arrays, the dense range becomes a bitset
+    DocumentBitmap lhs;
+    DocumentBitmap rhs;
+    std::set<int> lhs_ids;
+    std::set<int> rhs_ids;
+    for (int id = 0; id < 10000; id += 2) {
+        lhs.Add(id);
+        lhs_ids.insert(id);
+    }
+    for (int id = 5000; id < 200000; id += 7) {
+        rhs.Add(id);
+        rhs_ids.insert(id);
+    }
+    lhs.Add(1 << 20);
+    lhs_ids.insert(1 << 20);
+    lhs.Remove(4);
+    lhs_ids.erase(4);
+    ASSERT_EQUAL(lhs.GetSize(), lhs_ids.size());
+    ASSERT(std::equal(lhs.begin(), lhs.end(), lhs_ids.begin(), lhs_ids.end()));
+    ASSERT_EQUAL(lhs.GetMin(), 0);
+    ASSERT_EQUAL(lhs.GetMax(), 1 << 20);
+    ASSERT(!lhs.Contains(4) && lhs.Contains(6) && !lhs.Contains(7));
+
+    const auto check = [](const DocumentBitmap& bitmap, const std::set<int>& ids) {
+        ASSERT_EQUAL(bitmap.GetSize(), ids.size());
+        ASSERT(std::equal(bitmap.begin(), bitmap.end(), ids.begin(), ids.end()));
+    };
+    std::set<int> expected;
+    std::set_intersection(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(),
+                          std::inserter(expected, expected.end()));
+    check(lhs & rhs, expected);
+    expected.clear();
+    std::set_union(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(),
+                   std::inserter(expected, expected.end()));
+    check(lhs | rhs, expected);
+    expected.clear();
+    std::set_difference(lhs_ids.begin(), lhs_ids.end(), rhs_ids.begin(), rhs_ids.end(),
+                        std::inserter(expected, expected.end()));
+    check(lhs - rhs, expected);
+    ASSERT((lhs | rhs) - rhs == lhs - rhs);
+
+    try {
+        lhs.Add(-1);
+        ASSERT_HINT(false, "Negative ids must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestAllowListSearch() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "nasty cat with big eyes"s, DocumentStatus::BANNED, {3});
+    server.AddDocument(4, "white dog"s, DocumentStatus::ACTUAL, {4});
+    server.AddDocument(5, "cat and dog"s, DocumentStatus::IRRELEVANT, {5});
+
+    ASSERT((std::vector<int>(server.begin(), server.end()) == std::vector<int>{1, 2, 3, 4, 5}));
+    ASSERT_EQUAL(server.GetDocumentIds(DocumentStatus::ACTUAL).GetSize(), 3u);
+    ASSERT(server.GetDocumentIds(DocumentStatus::REMOVED).IsEmpty());
+
+    DocumentBitmap acl;
+    acl.Add(1);
+    acl.Add(3);
+    acl.Add(4);
+    const DocumentBitmap allowed = server.GetDocumentIds(DocumentStatus::ACTUAL) & acl;
+    const auto by_predicate = server.FindTopDocuments("white cat -tail"s,
+        [&acl](int document_id, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL && acl.Contains(document_id);
+        });
+    for (const auto& documents : {server.FindTopDocuments("white cat -tail"s, allowed),
+                                  server.FindTopDocuments(std::execution::par, "white cat -tail"s, allowed)}) {
+        ASSERT_EQUAL(documents.size(), 2u);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, by_predicate[i].id);
+            ASSERT(std::abs(documents[i].relevance - by_predicate[i].relevance) < PRECISION);
+        }
+    }
+    ASSERT(server.FindTopDocuments("cat"s, DocumentBitmap()).empty());
+
+    server.RemoveDocument(1);
+    ASSERT(!server.GetDocumentIds().Contains(1));
+    ASSERT(!server.GetDocumentIds(DocumentStatus::ACTUAL).Contains(1));
+    ASSERT_EQUAL(server.FindTopDocuments("white cat"s, server.GetDocumentIds(DocumentStatus::ACTUAL) & acl).size(), 1u);
+}
+
+void TestStatusPartitionedPostings() {
+    const std::vector<std::string> texts = {
+        "white cat and yellow hat"s, "curly cat curly tail"s, "nasty dog with big eyes"s,
+        "nasty pigeon john"s, "white dog"s, "cat and dog"s, "big yellow cat"s, "curly pigeon"s,
+    };
+    const std::vector<DocumentStatus> statuses = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                                  DocumentStatus::BANNED, DocumentStatus::REMOVED};
+    SearchServer server("and with"s);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        server.AddDocument(id, texts[id], statuses[id % statuses.size()], {id});
+    }
+
+    const auto check = [&server, &statuses](const std::string& query) {
+        for (const DocumentStatus status : statuses) {
+            const auto expected = server.FindTopDocuments(query,
+                [status](int, DocumentStatus document_status, int) {
+                    return document_status == status;
+                });
+            for (const auto& documents : {server.FindTopDocuments(query, status),
+                                          server.FindTopDocuments(std::execution::par, query, status)}) {
+                ASSERT_EQUAL(documents.size(), expected.size());
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    ASSERT_EQUAL(documents[i].id, expected[i].id);
+                    ASSERT(std::abs(documents[i].relevance - expected[i].relevance) < PRECISION);
+                }
+            }
+        }
+    };
+    check("cat"s);
+    check("curly nasty dog -eyes"s);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::BANNED).size(), 1u);
+
+    server.RemoveDocument(6);
+    server.SetForwardIndex(false);
+    server.RemoveDocument(std::execution::par, 2);
+    check("yellow big cat"s);
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty());
+    ASSERT(std::get<0>(server.MatchDocument("curly cat"s, 1)).size() == 2u);
+}
+
+void TestIndexArena() {
+    IndexArena arena;
+    void* small = arena.allocate(40, 8);
+    ASSERT_EQUAL(arena.GetChunkCount(), 1u);
+    // a freed block is given out again for a request of its size class
+    arena.deallocate(small, 40, 8);
+    ASSERT_EQUAL(arena.allocate(33, 8), small);
+    ASSERT(arena.allocate(48, 8) != small);
+
+    void* large = arena.allocate(IndexArena::MAX_POOLED_SIZE + 1, 64);
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(large) % 64, 0u);
+    ASSERT_EQUAL(arena.GetChunkCount(), 2u);
+    arena.deallocate(large, IndexArena::MAX_POOLED_SIZE + 1, 64);
+    ASSERT_EQUAL(arena.GetChunkCount(), 1u);
+
+    // containers may be dropped with the arena
+    std::pmr::map<int, std::pmr::string> words(&arena);
+    for (int i = 0; i < 100000; ++i) {
+        words.emplace(i, "a word longer than the short string buffer"s);
+    }
+    ASSERT(arena.GetChunkCount() > 1u);
+    ASSERT(arena.GetReservedBytes() >= 100000 * sizeof(std::pair<const int, std::pmr::string>));
+    new (&words) std::pmr::map<int, std::pmr::string>(&arena);
+    arena.Release();
+    ASSERT_EQUAL(arena.GetChunkCount(), 0u);
+    ASSERT_EQUAL(arena.GetReservedBytes(), 0u);
+
+    // the index of a server lives in its arena, postings removed in
+    // parallel are freed after the parallel part
+    auto server = std::make_unique<SearchServer>("and"s);
+    for (int id = 0; id < 1000; ++id) {
+        server->AddDocument(id, "cat and dog number "s + std::to_string(id % 37), DocumentStatus::ACTUAL, {id});
+    }
+    for (int id = 0; id < 1000; id += 3) {
+        server->RemoveDocument(std::execution::par, id);
+    }
+    server->AddDocument(1000, "cat number 5"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server->FindTopDocuments("number"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    ASSERT_EQUAL(server->GetDocumentCount(), 667);
+    server.reset();
+}
+
+void TestQueryPlanner() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 1000; ++id) {
+        std::string text = "cat"s;
+        if (id % 10 == 0) {
+            text += " dog"s;
+        }
+        if (id % 200 == 5) {
+            text += " parrot"s;
+        }
+        if (id % 400 == 1) {
+            text += " hamster"s;
+        }
+        if (id % 2 == 0) {
+            text += " curly"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+
+    // every document has "cat", it is read only when the other words
+    // match less than the top
+    const auto check = [&server](const std::string& query, bool reads_deferred) {
+        const auto [documents, trace] = server.ExplainTopDocuments(query);
+        const SearchPage page = server.FindDocumentsAfter(query, std::nullopt, MAX_RESULT_DOCUMENT_COUNT);
+        ASSERT_EQUAL(documents.size(), page.documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, page.documents[i].id);
+            ASSERT_EQUAL(documents[i].relevance, page.documents[i].relevance);
+        }
+        const auto par_documents = server.FindTopDocuments(std::execution::par, query);
+        ASSERT_EQUAL(par_documents.size(), documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(par_documents[i].id, documents[i].id);
+        }
+        ASSERT_EQUAL(trace.deferred_terms_read, reads_deferred);
+        return trace;
+    };
+    const QueryTrace dog_trace = check("cat dog"s, false);
+    ASSERT_EQUAL(dog_trace.terms.size(), 2u);
+    ASSERT_EQUAL(dog_trace.terms[0].word, "dog"s);
+    ASSERT(dog_trace.terms[1].is_deferred && !dog_trace.terms[0].is_deferred);
+    ASSERT_EQUAL(dog_trace.candidate_documents, 100u);
+    check("cat parrot"s, false);
+    check("cat hamster"s, true);
+    check("cat hamster -curly"s, true);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    // long lists over a dense range of ids are summed in an array
+    const auto [curly_documents, curly_trace] = server.ExplainTopDocuments("curly dog parrot"s);
+    ASSERT(curly_trace.match_strategy == MatchStrategy::TERM_AT_A_TIME);
+    ASSERT(curly_trace.minus_word_strategy == MinusWordStrategy::SCAN);
+    ASSERT_EQUAL(curly_documents.front().id, 805);
+    const auto [dog_documents, single_trace] = server.ExplainTopDocuments("dog"s);
+    ASSERT(single_trace.match_strategy == MatchStrategy::DOCUMENT_AT_A_TIME);
+
+    // a rare plus word looks its candidates up in long minus lists
+    const auto [parrot_documents, probe_trace] = server.ExplainTopDocuments("parrot hamster -curly -dog"s);
+    ASSERT(probe_trace.minus_word_strategy == MinusWordStrategy::PROBE);
+    ASSERT_EQUAL(probe_trace.terms[2].word, "curly"s);
+    ASSERT_EQUAL(probe_trace.rejected_by_minus_words, 0u);
+    ASSERT_EQUAL(parrot_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    const auto [curly_parrot_documents, curly_probe_trace] = server.ExplainTopDocuments("parrot hamster curly -dog"s);
+    ASSERT(curly_probe_trace.minus_word_strategy == MinusWordStrategy::SCAN);
+    ASSERT_EQUAL(curly_parrot_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    std::ostringstream out;
+    PrintQueryTrace(out, dog_trace);
+    ASSERT(out.str().find("deferred, skipped"s) != std::string::npos);
+}
+
+void TestSearchBudget() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 100; ++id) {
+        std::string text = "cat"s;
+        if (id % 10 == 0) {
+            text += " dog"s;
+        }
+        if (id % 25 == 3) {
+            text += " parrot"s;
+        }
+        if (id % 2 == 0) {
+            text += " curly"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+
+    // with enough budget the result is that of the ordinary search
+    for (const std::string& query : {"cat dog parrot"s, "cat parrot -curly"s, "dog curly"s}) {
+        const SearchResult result = server.FindTopDocuments(query, SearchBudget{});
+        const auto documents = server.FindTopDocuments(query);
+        ASSERT(!result.is_partial);
+        ASSERT_EQUAL(result.documents.size(), documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(result.documents[i].id, documents[i].id);
+            ASSERT(std::abs(result.documents[i].relevance - documents[i].relevance) < PRECISION);
+        }
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("cat dog parrot"s, SearchBudget{}).postings_scanned, 114u);
+
+    // the rarest word is read first, so a small budget finds its documents
+    SearchBudget budget;
+    budget.max_postings = 4;
+    const SearchResult parrot_result = server.FindTopDocuments("cat dog parrot"s, budget);
+    ASSERT(parrot_result.is_partial);
+    ASSERT_EQUAL(parrot_result.postings_scanned, 4u);
+    ASSERT_EQUAL(parrot_result.documents.size(), 4u);
+    ASSERT_EQUAL(parrot_result.documents[0].id, 53);
+    const SearchResult repeated_result = server.FindTopDocuments("cat dog parrot"s, budget);
+    ASSERT_EQUAL(repeated_result.documents.size(), parrot_result.documents.size());
+    for (size_t i = 0; i < parrot_result.documents.size(); ++i) {
+        ASSERT_EQUAL(repeated_result.documents[i].id, parrot_result.documents[i].id);
+        ASSERT_EQUAL(repeated_result.documents[i].relevance, parrot_result.documents[i].relevance);
+    }
+    for (const Document& document : server.FindTopDocuments("cat parrot -curly"s, budget).documents) {
+        ASSERT(document.id % 2 == 1);
+    }
+    budget.max_postings = 0;
+    ASSERT(server.FindTopDocuments("cat"s, budget).documents.empty());
+    ASSERT(!server.FindTopDocuments("hamster"s, budget).is_partial);
+
+    // an expired deadline stops the search before the first posting
+    SearchBudget expired_budget;
+    expired_budget.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    const SearchResult expired_result = server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, expired_budget);
+    ASSERT(expired_result.is_partial && expired_result.documents.empty());
+
+    budget.max_postings = 4;
+    const auto results = ProcessQueries(server, {"cat dog parrot"s, "hamster"s}, budget);
+    ASSERT_EQUAL(results.size(), 2u);
+    ASSERT(results[0].is_partial && !results[1].is_partial);
+    ASSERT_EQUAL(results[0].documents[0].id, 53);
+}
+
+void TestImpactIndex() {
+    SearchServer server("and"s);
+    // words of rank r appear about 1 / r of the times
+    uint32_t seed = 12345;
+    const auto next_random = [&seed] {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) & 0x7fff;
+    };
+    for (int id = 0; id < 2000; ++id) {
+        std::string text = "common"s;
+        const int word_count = 3 + next_random() % 20;
+        for (int i = 0; i < word_count; ++i) {
+            text += " w"s + std::to_string(1 + 200 / (1 + next_random() % 200));
+        }
+        const DocumentStatus status = id % 7 == 3 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, text, status, {static_cast<int>(next_random() % 100)});
+    }
+
+    const std::vector<std::string> queries = {
+        "w1"s, "w2 w3"s, "w40 w41 w42 w43 w44 w45 w46 w47"s, "w1 w2 w3 w4 w5 w6 w7 w8 w9 w10 w100 w200"s,
+        "w3 w50 -w1"s, "w2 w90 -w5 -w6"s, "common"s, "common w200"s, "common w150 w199 -w1"s, "missing"s,
+        "w1 w2 w3 w4 w5 -w1 -w2 -w3 -w4 -w5"s,
+    };
+    const auto even_rating = [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating % 2 == 0;
+    };
+    DocumentBitmap allowed_documents;
+    for (int id = 0; id < 2000; id += 3) {
+        allowed_documents.Add(id);
+    }
+    const auto search_all = [&] {
+        std::vector<std::vector<Document>> results;
+        for (const std::string& query : queries) {
+            results.push_back(server.FindTopDocuments(query));
+            results.push_back(server.FindTopDocuments(query, DocumentStatus::BANNED));
+            results.push_back(server.FindTopDocuments(query, even_rating));
+            results.push_back(server.FindTopDocuments(query, allowed_documents));
+        }
+        return results;
+    };
+
+    const auto expected = search_all();
+    ASSERT(!server.HasImpactIndex());
+    server.BuildImpactIndex();
+    ASSERT(server.HasImpactIndex());
+    const auto results = search_all();
+    ASSERT_EQUAL(results.size(), expected.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        ASSERT_EQUAL_HINT(results[i].size(), expected[i].size(), queries[i / 4]);
+        for (size_t j = 0; j < results[i].size(); ++j) {
+            ASSERT_EQUAL_HINT(results[i][j].id, expected[i][j].id, queries[i / 4]);
+            ASSERT_EQUAL_HINT(results[i][j].relevance, expected[i][j].relevance, queries[i / 4]);
+            ASSERT_EQUAL(results[i][j].rating, expected[i][j].rating);
+        }
+    }
+
+    // every document has "common" and more words
+    ASSERT(server.GetMemoryStats().impact_index.entries > server.GetDocumentIds().GetSize());
+
+    // the copy goes stale with the index
+    server.AddDocument(5000, "w1 w1 w1"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(!server.HasImpactIndex());
+    ASSERT_EQUAL(server.FindTopDocuments("w1"s).front().id, 5000);
+    server.BuildImpactIndex();
+    ASSERT_EQUAL(server.FindTopDocuments("w1"s).front().id, 5000);
+    server.RemoveDocument(5000);
+    ASSERT(!server.HasImpactIndex());
+
+    // memory of a search follows the documents read, not the range of ids
+    SearchServer sparse_server(""s);
+    sparse_server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, {1});
+    sparse_server.AddDocument(1, "black dog"s, DocumentStatus::ACTUAL, {2});
+    sparse_server.AddDocument(1'500'000'000, "cat cat dog"s, DocumentStatus::ACTUAL, {3});
+    sparse_server.AddDocument(2'000'000'000, "parrot"s, DocumentStatus::BANNED, {4});
+    std::vector<std::vector<Document>> sparse_expected;
+    for (const std::string& query : {"cat"s, "cat dog"s, "dog -white"s, "parrot"s}) {
+        sparse_expected.push_back(sparse_server.FindTopDocuments(query));
+    }
+    sparse_server.BuildImpactIndex();
+    size_t sparse_index = 0;
+    for (const std::string& query : {"cat"s, "cat dog"s, "dog -white"s, "parrot"s}) {
+        const auto documents = sparse_server.FindTopDocuments(query);
+        const auto& expected_documents = sparse_expected[sparse_index++];
+        ASSERT_EQUAL_HINT(documents.size(), expected_documents.size(), query);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL_HINT(documents[i].id, expected_documents[i].id, query);
+            ASSERT_EQUAL_HINT(documents[i].relevance, expected_documents[i].relevance, query);
+        }
+    }
+    ASSERT_EQUAL(sparse_server.FindTopDocuments("cat"s).front().id, 1'500'000'000);
+    ASSERT_EQUAL(sparse_server.FindTopDocuments("parrot"s, DocumentStatus::BANNED).front().id, 2'000'000'000);
+}
+
+void TestShardedSearchServer() {
+    const std::vector<std::string> texts = {
+        "white cat and yellow hat"s, "curly cat curly tail"s, "nasty dog with big eyes"s,
+        "nasty pigeon john"s, "white dog"s, "cat and dog"s, "big yellow cat"s, "curly pigeon"s,
+        "white white white hat"s, "tail of dog"s, "eyes of cat"s, "john and his dog"s,
+    };
+    SearchServer server("and of with"s);
+    ShardedSearchServer local_server("and of with"s, 3);
+    ShardedSearchServer socket_server("and of with"s, 4, ShardTransportType::SOCKET);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        const DocumentStatus status = id % 5 == 4 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, texts[id], status, {id % 3});
+        local_server.AddDocument(id, texts[id], status, {id % 3});
+        socket_server.AddDocument(id, texts[id], status, {id % 3});
+    }
+    ASSERT_EQUAL(local_server.GetDocumentCount(), server.GetDocumentCount());
+    ASSERT_EQUAL(socket_server.GetDocumentCount(), server.GetDocumentCount());
+
+    const auto check = [&](const std::string& query, DocumentStatus status) {
+        const auto expected = server.FindTopDocuments(query, status);
+        for (const auto& documents : {local_server.FindTopDocuments(query, status),
+                                      socket_server.FindTopDocuments(query, status)}) {
+            ASSERT_EQUAL(documents.size(), expected.size());
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_EQUAL(documents[i].id, expected[i].id);
+                ASSERT_EQUAL(documents[i].rating, expected[i].rating);
+                ASSERT(std::abs(documents[i].relevance - expected[i].relevance) < PRECISION);
+            }
+        }
+    };
+    check("cat"s, DocumentStatus::ACTUAL);
+    check("white curly dog -tail"s, DocumentStatus::ACTUAL);
+    check("nasty john eyes"s, DocumentStatus::BANNED);
+    check("cu* pigeon"s, DocumentStatus::ACTUAL);
+
+    server.RemoveDocument(1);
+    local_server.RemoveDocument(1);
+    socket_server.RemoveDocument(1);
+    check("curly cat"s, DocumentStatus::ACTUAL);
+
+    try {
+        socket_server.AddDocument(2, "duplicate id"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Errors of shards must be thrown"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    // words of a prefix with frequencies differing from shard to shard:
+    // the expansion limit keeps the words most frequent in the collection
+    const std::vector<std::string> prefix_words = {"pa"s, "pb"s, "pc"s, "pd"s, "pe"s};
+    for (int id = 100; id < 160; ++id) {
+        std::string text = "x"s + std::to_string(id % 3);
+        for (size_t i = 0; i < prefix_words.size(); ++i) {
+            if ((id * (i + 3)) % (i + 2) == 0 || id % 7 == static_cast<int>(i)) {
+                text += ' ' + prefix_words[i];
+            }
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 4});
+        local_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 4});
+        socket_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 4});
+    }
+    const auto unlimited = server.FindTopDocuments("x1 p*"s);
+    server.SetPrefixExpansionLimit(2);
+    local_server.SetPrefixExpansionLimit(2);
+    socket_server.SetPrefixExpansionLimit(2);
+    ASSERT_EQUAL(local_server.GetPrefixExpansionLimit(), 2u);
+    const auto limited = server.FindTopDocuments("x1 p*"s);
+    bool is_limit_reached = limited.size() != unlimited.size();
+    for (size_t i = 0; !is_limit_reached && i < limited.size(); ++i) {
+        is_limit_reached = limited[i].id != unlimited[i].id
+            || std::abs(limited[i].relevance - unlimited[i].relevance) >= PRECISION;
+    }
+    ASSERT_HINT(is_limit_reached, "The query must expand past the limit"s);
+    check("p*"s, DocumentStatus::ACTUAL);
+    check("x1 p*"s, DocumentStatus::ACTUAL);
+    check("x2 -p*"s, DocumentStatus::ACTUAL);
+    check("pe x0 -pa*"s, DocumentStatus::ACTUAL);
+    try {
+        local_server.SetPrefixExpansionLimit(0);
+        ASSERT_HINT(false, "Prefix expansion limit must be positive"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    // a count from the wire larger than the message is an error, not
+    // an allocation
+    SearchServer shard("and"s);
+    ShardService service(shard);
+    WireWriter request;
+    request.WriteUint(static_cast<uint64_t>(ShardRequest::ADD_DOCUMENT));
+    request.WriteInt(1);
+    request.WriteString("cat"s);
+    request.WriteUint(static_cast<uint64_t>(DocumentStatus::ACTUAL));
+    request.WriteUint(uint64_t(1) << 60);
+    request.WriteInt(5);
+    const std::string response = service.Handle(request.GetData());
+    WireReader reader(response);
+    ASSERT_HINT(reader.ReadUint() != 0, "The request must fail"s);
+    ASSERT_EQUAL(shard.GetDocumentCount(), 0);
+}
+
+void TestQueryServer() {
+    SearchServer search_server("and with"s);
+    QueryServerOptions options;
+    options.unix_socket_path = "/tmp/search_server_test_"s + std::to_string(getpid()) + ".sock"s;
+    options.worker_count = 2;
+    QueryServer server(search_server, options);
+    std::thread loop([&server] { server.Run(); });
+
+    {
+        QueryClient client(options.unix_socket_path);
+        client.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1, 2});
+        client.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7});
+        const auto documents = client.FindTopDocuments("curly cat"s);
+        ASSERT_EQUAL(documents.size(), 2u);
+        ASSERT_EQUAL(documents[0].id, 2);
+        const auto [words, status] = client.MatchDocument("white dog"s, 1);
+        ASSERT_EQUAL(words.size(), 1u);
+        ASSERT_EQUAL(words[0], "white"s);
+        try {
+            client.AddDocument(1, "duplicate"s, DocumentStatus::ACTUAL, {});
+            ASSERT_HINT(false, "Errors of the server must be thrown"s);
+        } catch (const std::invalid_argument&) {
+        }
+
+        // pipelined requests see the writes sent before them
+        QueryRequest add;
+        add.type = QueryRequestType::ADD_DOCUMENT;
+        add.document_id = 3;
+        add.text = "nasty cat"s;
+        client.Send(add);
+        QueryRequest search;
+        search.text = "cat"s;
+        std::set<uint64_t> ids;
+        for (int i = 0; i < 100; ++i) {
+            ids.insert(client.Send(search));
+        }
+        client.Flush();
+        ASSERT(!client.Receive().is_error);
+        for (int i = 0; i < 100; ++i) {
+            const QueryResponse response = client.Receive();
+            ASSERT_EQUAL(ids.erase(response.id), 1u);
+            ASSERT_EQUAL(response.documents.size(), 3u);
+        }
+    }
+
+    server.Stop();
+    loop.join();
+
+    // a frame with bytes after the message is malformed
+    QueryRequest request;
+    request.id = 7;
+    request.text = "cat"s;
+    ASSERT_EQUAL(DecodeRequest(EncodeRequest(request)).id, 7u);
+    try {
+        DecodeRequest(EncodeRequest(request) + "x"s);
+        ASSERT_HINT(false, "Trailing bytes must be rejected"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestAdmissionController() {
+    using namespace std::chrono_literals;
+    AdmissionOptions options;
+    options.max_in_flight = 2;
+    options.target_delay = 5ms;
+    options.interval = 100ms;
+    AdmissionController controller(options);
+
+    ASSERT(controller.TryEnter() && controller.TryEnter());
+    ASSERT(!controller.TryEnter());
+    controller.Leave();
+    ASSERT(controller.TryEnter());
+
+    // the delay has to stay above the target for an interval, then
+    // queries are shed at a growing rate and the others degraded
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT(controller.Admit(1ms, start) == AdmissionDecision::ADMIT);
+    ASSERT(controller.Admit(10ms, start) == AdmissionDecision::ADMIT);
+    ASSERT(controller.Admit(10ms, start + 50ms) == AdmissionDecision::ADMIT);
+    ASSERT(controller.Admit(10ms, start + 100ms) == AdmissionDecision::SHED);
+    ASSERT(controller.Admit(10ms, start + 150ms) == AdmissionDecision::DEGRADE);
+    ASSERT(controller.Admit(10ms, start + 200ms) == AdmissionDecision::SHED);
+    ASSERT(controller.Admit(10ms, start + 250ms) == AdmissionDecision::DEGRADE);
+    ASSERT(controller.Admit(10ms, start + 271ms) == AdmissionDecision::SHED);
+    ASSERT(controller.Admit(10ms, start + 272ms, false) == AdmissionDecision::ADMIT);
+    ASSERT(controller.GetStatistics().is_overloaded);
+    ASSERT(controller.Admit(1ms, start + 300ms) == AdmissionDecision::ADMIT);
+
+    const AdmissionController::Statistics statistics = controller.GetStatistics();
+    ASSERT(!statistics.is_overloaded);
+    ASSERT_EQUAL(statistics.admitted, 5u);
+    ASSERT_EQUAL(statistics.degraded, 2u);
+    ASSERT_EQUAL(statistics.shed, 3u);
+    ASSERT_EQUAL(statistics.rejected, 1u);
+    ASSERT_EQUAL(statistics.in_flight, 2u);
+    std::ostringstream out;
+    controller.WritePrometheus(out);
+    ASSERT(out.str().find("search_server_admission_queries_total{decision=\"shed\"} 3\n"s) != std::string::npos);
+
+    // a server without room for queries still accepts writes
+    SearchServer search_server("and"s);
+    QueryServerOptions server_options;
+    server_options.unix_socket_path = "/tmp/search_server_admission_test_"s + std::to_string(getpid()) + ".sock"s;
+    server_options.worker_count = 1;
+    server_options.admission.max_in_flight = 0;
+    QueryServer server(search_server, server_options);
+    std::thread loop([&server] { server.Run(); });
+    {
+        QueryClient client(server_options.unix_socket_path);
+        client.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+        try {
+            client.FindTopDocuments("cat"s);
+            ASSERT_HINT(false, "Queries over the limit must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+        ASSERT_EQUAL(server.GetAdmissionController().GetStatistics().rejected, 1u);
+    }
+    server.Stop();
+    loop.join();
+}
+
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
     RUN_TEST(TestExcludeMinusWordsFromSearchResults);
@@ -233,4 +1420,28 @@ void TestSearchServer() {
     RUN_TEST(TestPredicateFunction);
     RUN_TEST(TestFilterByStatus);
     RUN_TEST(TestCorrectRelevanceDocument);
+    RUN_TEST(TestDuplicatePolicy);
+    RUN_TEST(TestNearDuplicates);
+    RUN_TEST(TestConcurrentRequestQueue);
+    RUN_TEST(TestSearchAfterPagination);
+    RUN_TEST(TestForEachMatch);
+    RUN_TEST(TestSearchMetrics);
+    RUN_TEST(TestExplainTopDocuments);
+    RUN_TEST(TestRequestQueueLog);
+    RUN_TEST(TestMemoryStats);
+    RUN_TEST(TestTermCountRelevance);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestPrefixQueries);
+    RUN_TEST(TestMatchDocuments);
+    RUN_TEST(TestForwardIndex);
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestAllowListSearch);
+    RUN_TEST(TestStatusPartitionedPostings);
+    RUN_TEST(TestIndexArena);
+    RUN_TEST(TestQueryPlanner);
+    RUN_TEST(TestSearchBudget);
+    RUN_TEST(TestImpactIndex);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestQueryServer);
+    RUN_TEST(TestAdmissionController);
 }
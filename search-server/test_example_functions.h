@@ -3,6 +3,13 @@
 #include <string>
 #include "document.h"
 #include "search_server.h"
+#include "near_duplicates.h"
+#include "concurrent_request_queue.h"
+#include "request_queue.h"
+#include "sharded_search_server.h"
+#include "query_server.h"
+#include "query_client.h"
+#include "process_queries.h"
 
 using std::literals::string_literals::operator""s;
 
@@ -54,6 +61,30 @@ void TestAverageRatingResult();
 void TestPredicateFunction(); 
 void TestFilterByStatus(); 
 void TestCorrectRelevanceDocument(); 
+void TestDuplicatePolicy();
+void TestNearDuplicates();
+void TestConcurrentRequestQueue();
+void TestSearchAfterPagination();
+void TestForEachMatch();
+void TestSearchMetrics();
+void TestExplainTopDocuments();
+void TestRequestQueueLog();
+void TestMemoryStats();
+void TestTermCountRelevance();
+void TestPhraseQueries();
+void TestPrefixQueries();
+void TestMatchDocuments();
+void TestForwardIndex();
+void TestDocumentBitmap();
+void TestAllowListSearch();
+void TestStatusPartitionedPostings();
+void TestIndexArena();
+void TestQueryPlanner();
+void TestSearchBudget();
+void TestImpactIndex();
+void TestShardedSearchServer();
+void TestQueryServer();
+void TestAdmissionController();
 
 // Entry point to unit tests
 void TestSearchServer(); 
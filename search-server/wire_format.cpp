@@ -0,0 +1,145 @@
+#include "wire_format.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::literals::string_literals::operator""s;
+
+void WireWriter::WriteUint(uint64_t value) {
+    while (value >= 0x80) {
+        data_.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    data_.push_back(static_cast<char>(value));
+}
+
+void WireWriter::WriteInt(int64_t value) {
+    WriteUint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void WireWriter::WriteDouble(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        data_.push_back(static_cast<char>(bits >> (8 * i)));
+    }
+}
+
+void WireWriter::WriteString(std::string_view value) {
+    WriteUint(value.size());
+    data_.append(value);
+}
+
+uint64_t WireReader::ReadUint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position_ >= data_.size()) {
+            throw std::invalid_argument("Message is truncated"s);
+        }
+        const uint8_t byte = static_cast<uint8_t>(data_[position_++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::invalid_argument("Integer of message is too long"s);
+}
+
+int64_t WireReader::ReadInt() {
+    const uint64_t value = ReadUint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+double WireReader::ReadDouble() {
+    if (data_.size() - position_ < 8) {
+        throw std::invalid_argument("Message is truncated"s);
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_[position_++])) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string_view WireReader::ReadString() {
+    const uint64_t size = ReadUint();
+    if (data_.size() - position_ < size) {
+        throw std::invalid_argument("Message is truncated"s);
+    }
+    const std::string_view value = data_.substr(position_, size);
+    position_ += size;
+    return value;
+}
+
+void WriteStatus(WireWriter& writer, DocumentStatus status) {
+    writer.WriteUint(static_cast<uint64_t>(status));
+}
+
+DocumentStatus ReadStatus(WireReader& reader) {
+    const uint64_t status = reader.ReadUint();
+    if (status > static_cast<uint64_t>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("Unknown document status "s + std::to_string(status));
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+void AppendFrame(std::string& out, std::string_view message) {
+    const uint32_t size = static_cast<uint32_t>(message.size());
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(size >> (8 * i)));
+    }
+    out.append(message);
+}
+
+size_t GetFrameSize(std::string_view data) {
+    if (data.size() < 4) {
+        return 0;
+    }
+    uint32_t size = 0;
+    for (int i = 0; i < 4; ++i) {
+        size |= static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    }
+    return data.size() - 4 < size ? 0 : size + 4;
+}
+
+void WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        // a closed connection is reported as EPIPE instead of SIGPIPE
+        const ssize_t written = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Write failed: "s + std::strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+bool ReadFrame(int fd, std::string& buffer, std::string& message) {
+    char chunk[65536];
+    while (true) {
+        const size_t frame_size = GetFrameSize(buffer);
+        if (frame_size > 0) {
+            message.assign(buffer, 4, frame_size - 4);
+            buffer.erase(0, frame_size);
+            return true;
+        }
+        const ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Read failed: "s + std::strerror(errno));
+        }
+        if (count == 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(count));
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "document.h"
+
+// Binary encoding of messages between processes: integers are varints
+// (signed ones zigzag-encoded), doubles are their 8 bytes in little
+// endian order, strings are a varint length and the bytes
+class WireWriter {
+public:
+    void WriteUint(uint64_t value);
+    void WriteInt(int64_t value);
+    void WriteDouble(double value);
+    void WriteString(std::string_view value);
+
+    const std::string& GetData() const {
+        return data_;
+    }
+
+    std::string Release() {
+        return std::move(data_);
+    }
+
+private:
+    std::string data_;
+};
+
+// Reads what WireWriter wrote, throws std::invalid_argument on
+// truncated or malformed data
+class WireReader {
+public:
+    explicit WireReader(std::string_view data)
+        : data_(data) {
+    }
+
+    uint64_t ReadUint();
+    int64_t ReadInt();
+    double ReadDouble();
+    // the view points into the data of the reader
+    std::string_view ReadString();
+
+    bool IsAtEnd() const {
+        return position_ == data_.size();
+    }
+
+private:
+    std::string_view data_;
+    size_t position_ = 0;
+};
+
+// Document status as a varint, reading throws std::invalid_argument on
+// unknown values
+void WriteStatus(WireWriter& writer, DocumentStatus status);
+DocumentStatus ReadStatus(WireReader& reader);
+
+// Frames on a stream: 4 bytes of little endian length and the message
+void AppendFrame(std::string& out, std::string_view message);
+
+// Returns the length of the first frame of data including its header,
+// or 0 if the frame isn't complete yet
+size_t GetFrameSize(std::string_view data);
+
+inline std::string_view GetFrameMessage(std::string_view frame) {
+    return frame.substr(4);
+}
+
+// Blocking I/O of frames on a socket, throw std::runtime_error
+// on errors of the system
+void WriteAll(int fd, std::string_view data);
+
+// Reads the next frame into message, buffer keeps bytes read after it.
+// Returns false if the other side closed the connection
+bool ReadFrame(int fd, std::string& buffer, std::string& message);